@@ -0,0 +1,61 @@
+
+/************************************************************************/
+/* author: Yanyang Xiao                                                 */
+/* email : yanyangxiaoxyy@gmail.com                                     */
+/************************************************************************/
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+/**
+* counts global operator new calls when VOROAPPROX_COUNT_ALLOCATIONS is defined
+* define ALLOC_COUNTER_IMPLEMENTATION in exactly one source file, like stb
+*/
+#ifdef VOROAPPROX_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+extern std::atomic<long long> g_allocCount;
+
+inline long long alloc_count()
+{
+	return g_allocCount.load();
+}
+
+#ifdef ALLOC_COUNTER_IMPLEMENTATION
+
+std::atomic<long long> g_allocCount(0);
+
+void* operator new(std::size_t size)
+{
+	++g_allocCount;
+
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+/**
+* author: Yanyang Xiao
+* email : yanyangxiaoxyy@gmail.com
+*/
+
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace xyy
+{
+	/**
+	* discrete distribution over [0, n), built in O(n) (Vose), sampled in O(1)
+	* bin i keeps i with probability _prob[i], otherwise gives _alias[i]
+	*/
+	class AliasTable
+	{
+	private:
+		std::vector<double> _prob;
+		std::vector<int>    _alias;
+
+		// scratch, kept to avoid reallocating on rebuild
+		std::vector<int>    _small;
+		std::vector<int>    _large;
+
+	public:
+		// weights >= 0, false if they sum to zero
+		bool build(const double *weights, int n)
+		{
+			_prob.resize(n);
+			_alias.resize(n);
+
+			double sum = 0.0;
+			for (int i = 0; i < n; ++i)
+				sum += weights[i];
+
+			if (n < 1 || !(sum > 0.0))
+			{
+				_prob.clear();
+				_alias.clear();
+				return false;
+			}
+
+			_small.clear();
+			_large.clear();
+
+			double scale = n / sum;
+			for (int i = 0; i < n; ++i)
+			{
+				_prob[i] = weights[i] * scale;
+				_alias[i] = i;
+
+				if (_prob[i] < 1.0)
+					_small.push_back(i);
+				else
+					_large.push_back(i);
+			}
+
+			while (!_small.empty() && !_large.empty())
+			{
+				int s = _small.back();
+				int l = _large.back();
+				_small.pop_back();
+
+				_alias[s] = l;
+				_prob[l] -= 1.0 - _prob[s];
+
+				if (_prob[l] < 1.0)
+				{
+					_large.pop_back();
+					_small.push_back(l);
+				}
+			}
+
+			// whatever is left is 1 up to rounding
+			for (size_t k = 0; k < _small.size(); ++k)
+				_prob[_small[k]] = 1.0;
+			for (size_t k = 0; k < _large.size(); ++k)
+				_prob[_large[k]] = 1.0;
+
+			return true;
+		}
+
+		int size() const { return (int)_prob.size(); }
+		bool empty() const { return _prob.empty(); }
+
+		// u picks the bin, v the coin, both in [0, 1)
+		int sample(double u, double v) const
+		{
+			int i = (int)(u * _prob.size());
+			if (i >= size())
+				i = size() - 1;
+
+			return v < _prob[i] ? i : _alias[i];
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,200 @@
+
+#include <math.h>
+#include <algorithm>
+#include "jumpflood.h"
+
+namespace xyy
+{
+	void JumpFlood::compute(
+		const double *sites,
+		int n,
+		int width,
+		int height,
+		int *labels,
+		PixelSets *pixels,
+		Workspace *workspace)
+	{
+		int pnb = width * height;
+		std::fill(labels, labels + pnb, -1);
+
+		Workspace local;
+		Workspace &ws = workspace ? *workspace : local;
+
+		// sites in pixel coordinates
+		double scale = 0.5 * width;
+		std::vector<double> &pos = ws.sites;
+		pos.resize(2 * n);
+		for (int v = 0; v < n; ++v)
+		{
+			pos[2 * v] = (sites[2 * v] + 1.0) * scale;
+			pos[2 * v + 1] = sites[2 * v + 1] * scale + 0.5 * height;
+
+			int i = std::min(width - 1, std::max(0, (int)floor(pos[2 * v])));
+			int j = std::min(height - 1, std::max(0, (int)floor(pos[2 * v + 1])));
+			seed(width, height, i, j, v, labels);
+		}
+
+		std::vector<int> &buffer = ws.labels;
+		buffer.resize(pnb);
+		int *src = labels;
+		int *dst = &buffer[0];
+
+		int step = 1;
+		while (2 * step < std::max(width, height))
+			step *= 2;
+
+		// 1+JFA, a unit pass first spreads seeds that share a neighborhood
+		flood(&pos[0], width, height, 1, src, dst);
+		std::swap(src, dst);
+
+		for (; step > 0; step /= 2)
+		{
+			flood(&pos[0], width, height, step, src, dst);
+			std::swap(src, dst);
+		}
+
+		// JFA+1, fixes most of the remaining errors
+		flood(&pos[0], width, height, 1, src, dst);
+		std::swap(src, dst);
+
+		if (src != labels)
+			std::copy(src, src + pnb, labels);
+
+		if (pixels)
+			extract_spans(labels, n, width, height, *pixels, &ws);
+	}
+
+	void JumpFlood::seed(int width, int height, int i, int j, int v, int *labels)
+	{
+		// sites sharing a pixel would lose their whole cell, so move the later
+		// one to a free neighbor, distances are always measured to the true site
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int nj = std::max(0, j - r); nj <= std::min(height - 1, j + r); ++nj)
+			{
+				for (int ni = std::max(0, i - r); ni <= std::min(width - 1, i + r); ++ni)
+				{
+					if (labels[nj * width + ni] < 0)
+					{
+						labels[nj * width + ni] = v;
+						return;
+					}
+				}
+			}
+		}
+	}
+
+	void JumpFlood::flood(const double *sites, int width, int height, int step, const int *src, int *dst)
+	{
+#pragma omp parallel for schedule(static)
+		for (int j = 0; j < height; ++j)
+		{
+			double y = j + 0.5;
+
+			for (int i = 0; i < width; ++i)
+			{
+				double x = i + 0.5;
+
+				int best = src[j * width + i];
+				double bestDist = 1e300;
+				if (best >= 0)
+				{
+					double dx = sites[2 * best] - x;
+					double dy = sites[2 * best + 1] - y;
+					bestDist = dx * dx + dy * dy;
+				}
+
+				for (int dj = -step; dj <= step; dj += step)
+				{
+					int nj = j + dj;
+					if (nj < 0 || nj >= height)
+						continue;
+
+					for (int di = -step; di <= step; di += step)
+					{
+						int ni = i + di;
+						if (ni < 0 || ni >= width)
+							continue;
+
+						int v = src[nj * width + ni];
+						if (v < 0 || v == best)
+							continue;
+
+						double dx = sites[2 * v] - x;
+						double dy = sites[2 * v + 1] - y;
+						double dist = dx * dx + dy * dy;
+
+						if (dist < bestDist || (dist == bestDist && v < best))
+						{
+							best = v;
+							bestDist = dist;
+						}
+					}
+				}
+
+				dst[j * width + i] = best;
+			}
+		}
+	}
+
+	void JumpFlood::extract_spans(
+		const int *labels,
+		int n,
+		int width,
+		int height,
+		PixelSets &pixels,
+		Workspace *workspace)
+	{
+		Workspace local;
+		Workspace &ws = workspace ? *workspace : local;
+
+		std::vector<int> &ymin = ws.ymin;
+		std::vector<int> &ymax = ws.ymax;
+		ymin.assign(n, height);
+		ymax.assign(n, -1);
+
+		for (int j = 0; j < height; ++j)
+		{
+			const int *line = &labels[j * width];
+			for (int i = 0; i < width; ++i)
+			{
+				int v = line[i];
+				if (v < 0 || (i > 0 && line[i - 1] == v))
+					continue;
+
+				ymin[v] = std::min(ymin[v], j);
+				ymax[v] = std::max(ymax[v], j);
+			}
+		}
+
+		pixels.clear();
+		pixels.resize(n);
+		for (int v = 0; v < n; ++v)
+		{
+			pixels.set_rows(v, ymin[v], ymax[v]);
+
+			int rows = std::max(0, ymax[v] - ymin[v] + 1);
+			std::fill(pixels.left(v), pixels.left(v) + rows, width);
+			std::fill(pixels.right(v), pixels.right(v) + rows, -1);
+		}
+
+		// each (cell, row) entry is touched by one row only
+#pragma omp parallel for schedule(static)
+		for (int j = 0; j < height; ++j)
+		{
+			const int *line = &labels[j * width];
+			for (int i = 0; i < width; ++i)
+			{
+				int v = line[i];
+				if (v < 0)
+					continue;
+
+				int loc = j - ymin[v];
+				int *left = pixels.left(v);
+				int *right = pixels.right(v);
+				left[loc] = std::min(left[loc], i);
+				right[loc] = std::max(right[loc], i);
+			}
+		}
+	}
+}
@@ -0,0 +1,61 @@
+
+/**
+* author: Yanyang Xiao
+* email : yanyangxiaoxyy@gmail.com
+*/
+
+#ifndef JUMP_FLOOD_H
+#define JUMP_FLOOD_H
+
+#include <cstddef>
+#include <vector>
+#include "pixelset.h"
+
+namespace xyy
+{
+	/**
+	* discrete Voronoi diagram of sites in [-1, 1] x [-h/w, h/w] on the pixel grid
+	* jump flooding (with one extra unit pass) labels every pixel center with its nearest site
+	*/
+	class JumpFlood
+	{
+	public:
+		// scratch buffers, keep one alive to avoid reallocating per call
+		struct Workspace
+		{
+			std::vector<double> sites;
+			std::vector<int>    labels;
+			std::vector<int>    ymin;
+			std::vector<int>    ymax;
+		};
+
+
+		/**
+		* labels (width * height) gets the nearest site of each pixel
+		* pixels (may be NULL) gets the per-site spans
+		* workspace (may be NULL) holds the scratch buffers
+		*/
+		static void compute(
+			const double *sites,
+			int n,
+			int width,
+			int height,
+			int *labels,
+			PixelSets *pixels = NULL,
+			Workspace *workspace = NULL);
+
+		static void extract_spans(
+			const int *labels,
+			int n,
+			int width,
+			int height,
+			PixelSets &pixels,
+			Workspace *workspace = NULL);
+
+	protected:
+		static void seed(int width, int height, int i, int j, int v, int *labels);
+		static void flood(const double *sites, int width, int height, int step, const int *src, int *dst);
+	};
+}
+
+#endif
@@ -0,0 +1,91 @@
+
+/**
+* author: Yanyang Xiao
+* email : yanyangxiaoxyy@gmail.com
+*/
+
+#ifndef LEGENDRE_H
+#define LEGENDRE_H
+
+namespace xyy
+{
+	/**
+	* tensor Legendre basis on [-1, 1]^2, term k is P_ex[k](u) * P_ey[k](v)
+	* terms are sorted by total degree, highest first, so the basis of degree d - 1 is the trailing block
+	* degree 2: P2(u), P1(u)P1(v), P2(v), P1(u), P1(v), 1
+	*/
+	struct Legendre
+	{
+		enum { MaxDegree = 4, MaxTerms = (MaxDegree + 1) * (MaxDegree + 2) / 2 };
+
+		static int terms_number(int degree)
+		{
+			return (degree + 1) * (degree + 2) / 2;
+		}
+
+		static void exponents(int degree, int *ex, int *ey)
+		{
+			int k = 0;
+			for (int t = degree; t >= 0; --t)
+			{
+				for (int a = t; a >= 0; --a)
+				{
+					ex[k] = a;
+					ey[k] = t - a;
+					++k;
+				}
+			}
+		}
+
+		// position of P_a(u) * P_b(v) in the basis of the given degree
+		static int index(int degree, int a, int b)
+		{
+			int t = a + b;
+			return terms_number(degree) - terms_number(t) + (t - a);
+		}
+
+		// p[a] = P_a(u), a <= degree
+		template <typename Real>
+		static void values(int degree, Real u, Real *p)
+		{
+			p[0] = Real(1.0);
+			if (degree > 0)
+				p[1] = u;
+
+			for (int n = 1; n < degree; ++n)
+				p[n + 1] = ((2 * n + 1) * u * p[n] - n * p[n - 1]) / (n + 1);
+		}
+
+		// P_a(u) = sum_p monomials()[a * (MaxDegree + 1) + p] * u^p
+		static const double* monomials()
+		{
+			static const double table[(MaxDegree + 1) * (MaxDegree + 1)] =
+			{
+				1.0,   0.0,   0.0,   0.0,   0.0,
+				0.0,   1.0,   0.0,   0.0,   0.0,
+				-0.5,  0.0,   1.5,   0.0,   0.0,
+				0.0,   -1.5,  0.0,   2.5,   0.0,
+				0.375, 0.0,   -3.75, 0.0,   4.375
+			};
+
+			return table;
+		}
+
+		// u^p = sum_a powers()[p * (MaxDegree + 1) + a] * P_a(u)
+		static const double* powers()
+		{
+			static const double table[(MaxDegree + 1) * (MaxDegree + 1)] =
+			{
+				1.0,        0.0,       0.0,         0.0,       0.0,
+				0.0,        1.0,       0.0,         0.0,       0.0,
+				1.0 / 3.0,  0.0,       2.0 / 3.0,   0.0,       0.0,
+				0.0,        0.6,       0.0,         0.4,       0.0,
+				7.0 / 35.0, 0.0,       20.0 / 35.0, 0.0,       8.0 / 35.0
+			};
+
+			return table;
+		}
+	};
+}
+
+#endif
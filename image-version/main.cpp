@@ -2,6 +2,9 @@
 #include "mainwindow.h"
 #include "../xlog.h"
 
+#define ALLOC_COUNTER_IMPLEMENTATION
+#include "../alloc_counter.h"
+
 #define WINWIDTH 1200
 #define WINHEIGHT 800
 
@@ -197,7 +197,7 @@ void MainWindow::init_parameter_widget()
 	degreeBox->setFontSize(16);
 	degreeBox->setSpinnable(true);
 	degreeBox->setMinValue(0);
-	degreeBox->setMaxValue(2);
+	degreeBox->setMaxValue(Legendre::MaxDegree);
 	degreeBox->setValueIncrement(1);
 	degreeBox->setCallback([&](int a)
 	{
@@ -255,6 +255,21 @@ void MainWindow::init_parameter_widget()
 		_params.stepScale = a;
 	});
 
+	_params.tolerance = 25.0;
+	new nanogui::Label(paraLayout, "tolerance:", "sans-bold");
+	nanogui::FloatBox<double> *toleranceBox = new nanogui::FloatBox<double>(paraLayout);
+	toleranceBox->setEditable(true);
+	toleranceBox->setFixedSize(Eigen::Vector2i(100, 20));
+	toleranceBox->setValue(_params.tolerance);
+	toleranceBox->setFontSize(16);
+	toleranceBox->setSpinnable(true);
+	toleranceBox->setMinValue(0.1);
+	toleranceBox->setValueIncrement(5.0);
+	toleranceBox->setCallback([&](double a)
+	{
+		_params.tolerance = a;
+	});
+
 	_params.approxScale = 1.0f;
 	new nanogui::Label(paraLayout, "approx scale:", "sans-bold");
 	nanogui::FloatBox<float> *approxScaleBox = new nanogui::FloatBox<float>(paraLayout);
@@ -350,6 +365,190 @@ void MainWindow::init_algorithm_widget()
 		}
 	});
 
+	nanogui::Button *cvtInitBtn = new nanogui::Button(initPopup, "cvt init");
+	cvtInitBtn->setCallback([&]
+	{
+		if (!_params.image || !_voroApprox)
+			return;
+
+		if (_params.approx)
+		{
+			delete[] _params.approx;
+			_params.approx = NULL;
+		}
+
+		_voroApprox->cvt_init(_params.sitesNumber);
+
+		if (_render)
+		{
+			std::vector<float> sites;
+			_voroApprox->sites_data(sites);
+			int n = (int)sites.size() / 2;
+			float *ptr = n > 0 ? &sites[0] : NULL;
+			_render->set_sites(ptr, n);
+
+			std::vector<float> corners;
+			std::vector<int> edges;
+			_voroApprox->voronoi_data(corners, edges);
+			n = (int)corners.size() / 2;
+			ptr = n > 0 ? &corners[0] : NULL;
+			int m = (int)edges.size() / 2;
+			int *indices = m > 0 ? &edges[0] : NULL;
+			_render->set_voronoi(ptr, n, indices, m);
+
+			_render->set_approx(NULL, 0, 0, 0);
+		}
+	});
+
+	nanogui::Button *importanceInitBtn = new nanogui::Button(initPopup, "importance init");
+	importanceInitBtn->setCallback([&]
+	{
+		if (!_params.image || !_voroApprox)
+			return;
+
+		if (_params.approx)
+		{
+			delete[] _params.approx;
+			_params.approx = NULL;
+		}
+
+		_voroApprox->importance_init(_params.sitesNumber);
+
+		if (_render)
+		{
+			std::vector<float> sites;
+			_voroApprox->sites_data(sites);
+			int n = (int)sites.size() / 2;
+			float *ptr = n > 0 ? &sites[0] : NULL;
+			_render->set_sites(ptr, n);
+
+			std::vector<float> corners;
+			std::vector<int> edges;
+			_voroApprox->voronoi_data(corners, edges);
+			n = (int)corners.size() / 2;
+			ptr = n > 0 ? &corners[0] : NULL;
+			int m = (int)edges.size() / 2;
+			int *indices = m > 0 ? &edges[0] : NULL;
+			_render->set_voronoi(ptr, n, indices, m);
+
+			_render->set_approx(NULL, 0, 0, 0);
+		}
+	});
+
+	nanogui::Button *slicInitBtn = new nanogui::Button(initPopup, "slic init");
+	slicInitBtn->setCallback([&]
+	{
+		if (!_params.image || !_voroApprox)
+			return;
+
+		if (_params.approx)
+		{
+			delete[] _params.approx;
+			_params.approx = NULL;
+		}
+
+		_voroApprox->slic_init(_params.sitesNumber);
+
+		if (_render)
+		{
+			std::vector<float> sites;
+			_voroApprox->sites_data(sites);
+			int n = (int)sites.size() / 2;
+			float *ptr = n > 0 ? &sites[0] : NULL;
+			_render->set_sites(ptr, n);
+
+			std::vector<float> corners;
+			std::vector<int> edges;
+			_voroApprox->voronoi_data(corners, edges);
+			n = (int)corners.size() / 2;
+			ptr = n > 0 ? &corners[0] : NULL;
+			int m = (int)edges.size() / 2;
+			int *indices = m > 0 ? &edges[0] : NULL;
+			_render->set_voronoi(ptr, n, indices, m);
+
+			_render->set_approx(NULL, 0, 0, 0);
+		}
+	});
+
+	_params.labelGradient = false;
+	nanogui::CheckBox *labelGradientCheckBox = new nanogui::CheckBox(_panel, "label gradient", [&](bool state)
+	{
+		_params.labelGradient = state;
+		if (_voroApprox)
+		{
+			_voroApprox->set_label_gradient(state);
+		}
+	});
+	labelGradientCheckBox->setChecked(_params.labelGradient);
+
+	_params.discreteVoronoi = false;
+	nanogui::CheckBox *discreteVoronoiCheckBox = new nanogui::CheckBox(_panel, "discrete voronoi", [&](bool state)
+	{
+		_params.discreteVoronoi = state;
+		if (_voroApprox)
+		{
+			_voroApprox->set_discrete_voronoi(state);
+		}
+	});
+	discreteVoronoiCheckBox->setChecked(_params.discreteVoronoi);
+
+	_params.powerDiagram = false;
+	nanogui::CheckBox *powerDiagramCheckBox = new nanogui::CheckBox(_panel, "power diagram", [&](bool state)
+	{
+		_params.powerDiagram = state;
+		if (_voroApprox)
+		{
+			_voroApprox->set_power_diagram(state);
+		}
+	});
+	powerDiagramCheckBox->setChecked(_params.powerDiagram);
+
+	_params.adaptiveDegree = false;
+	nanogui::CheckBox *adaptiveDegreeCheckBox = new nanogui::CheckBox(_panel, "adaptive degree", [&](bool state)
+	{
+		_params.adaptiveDegree = state;
+		if (_voroApprox)
+		{
+			_voroApprox->set_adaptive_degree(state);
+		}
+	});
+	adaptiveDegreeCheckBox->setChecked(_params.adaptiveDegree);
+
+	_params.adaptiveSites = false;
+	nanogui::CheckBox *adaptiveSitesCheckBox = new nanogui::CheckBox(_panel, "split / merge sites", [&](bool state)
+	{
+		_params.adaptiveSites = state;
+		if (_voroApprox)
+		{
+			_voroApprox->set_adaptive_sites(state);
+		}
+	});
+	adaptiveSitesCheckBox->setChecked(_params.adaptiveSites);
+
+	// a site freezes after 3 iterations in which a full step would gain less than 1% of the mean cell energy
+	_params.freezeSites = false;
+	nanogui::CheckBox *freezeSitesCheckBox = new nanogui::CheckBox(_panel, "freeze settled sites", [&](bool state)
+	{
+		_params.freezeSites = state;
+		if (_voroApprox)
+		{
+			_voroApprox->set_freezing(state ? 0.01 : 0.0, 3);
+		}
+	});
+	freezeSitesCheckBox->setChecked(_params.freezeSites);
+
+	// early iterations fit on 1 / 16 of the pixels, climbing to all of them halfway through
+	_params.sampledFits = false;
+	nanogui::CheckBox *sampledFitsCheckBox = new nanogui::CheckBox(_panel, "sampled early fits", [&](bool state)
+	{
+		_params.sampledFits = state;
+		if (_voroApprox)
+		{
+			_voroApprox->set_sampling(state ? 1.0 / 16.0 : 1.0);
+		}
+	});
+	sampledFitsCheckBox->setChecked(_params.sampledFits);
+
 	nanogui::Button *optBtn = new nanogui::Button(_panel, "optimize");
 	optBtn->setCallback([&]()
 	{
@@ -385,6 +584,112 @@ void MainWindow::init_algorithm_widget()
 		}
 	});
 
+	// sites number is the budget, iteration the steps per round
+	nanogui::Button *toleranceBtn = new nanogui::Button(_panel, "optimize to tolerance");
+	toleranceBtn->setCallback([&]()
+	{
+		if (!_params.image || !_voroApprox)
+			return;
+
+		if (_params.approx)
+		{
+			delete[] _params.approx;
+			_params.approx = NULL;
+		}
+
+		_voroApprox->optimize_to_tolerance(_params.degree, _params.tolerance, _params.sitesNumber, _params.iteration, _params.stepScale);
+
+		if (_render)
+		{
+			std::vector<float> sites;
+			_voroApprox->sites_data(sites);
+			int n = (int)sites.size() / 2;
+			float *ptr = n > 0 ? &sites[0] : NULL;
+			_render->set_sites(ptr, n);
+
+			std::vector<float> corners;
+			std::vector<int> edges;
+			_voroApprox->voronoi_data(corners, edges);
+			n = (int)corners.size() / 2;
+			ptr = n > 0 ? &corners[0] : NULL;
+			int m = (int)edges.size() / 2;
+			int *indices = m > 0 ? &edges[0] : NULL;
+			_render->set_voronoi(ptr, n, indices, m);
+
+			_render->set_approx(NULL, 0, 0, 0);
+		}
+	});
+
+	nanogui::Button *multilevelBtn = new nanogui::Button(_panel, "optimize multilevel");
+	multilevelBtn->setCallback([&]()
+	{
+		if (!_params.image || !_voroApprox)
+			return;
+
+		if (_params.approx)
+		{
+			delete[] _params.approx;
+			_params.approx = NULL;
+		}
+
+		_voroApprox->optimize_multilevel(_params.degree, _params.sitesNumber, 3, _params.iteration, _params.stepScale);
+
+		if (_render)
+		{
+			std::vector<float> sites;
+			_voroApprox->sites_data(sites);
+			int n = (int)sites.size() / 2;
+			float *ptr = n > 0 ? &sites[0] : NULL;
+			_render->set_sites(ptr, n);
+
+			std::vector<float> corners;
+			std::vector<int> edges;
+			_voroApprox->voronoi_data(corners, edges);
+			n = (int)corners.size() / 2;
+			ptr = n > 0 ? &corners[0] : NULL;
+			int m = (int)edges.size() / 2;
+			int *indices = m > 0 ? &edges[0] : NULL;
+			_render->set_voronoi(ptr, n, indices, m);
+
+			_render->set_approx(NULL, 0, 0, 0);
+		}
+	});
+
+	nanogui::Button *localBtn = new nanogui::Button(_panel, "optimize local");
+	localBtn->setCallback([&]()
+	{
+		if (!_params.image || !_voroApprox)
+			return;
+
+		if (_params.approx)
+		{
+			delete[] _params.approx;
+			_params.approx = NULL;
+		}
+
+		_voroApprox->optimize_local(_params.degree, _params.iteration, _params.stepScale);
+
+		if (_render)
+		{
+			std::vector<float> sites;
+			_voroApprox->sites_data(sites);
+			int n = (int)sites.size() / 2;
+			float *ptr = n > 0 ? &sites[0] : NULL;
+			_render->set_sites(ptr, n);
+
+			std::vector<float> corners;
+			std::vector<int> edges;
+			_voroApprox->voronoi_data(corners, edges);
+			n = (int)corners.size() / 2;
+			ptr = n > 0 ? &corners[0] : NULL;
+			int m = (int)edges.size() / 2;
+			int *indices = m > 0 ? &edges[0] : NULL;
+			_render->set_voronoi(ptr, n, indices, m);
+
+			_render->set_approx(NULL, 0, 0, 0);
+		}
+	});
+
 	nanogui::Button *approxBtn = new nanogui::Button(_panel, "approximate");
 	approxBtn->setCallback([&]()
 	{
@@ -25,6 +25,14 @@ class MainWindow : public nanogui::Screen
 		int sitesNumber;
 		int iteration;
 		double stepScale;
+		double tolerance;
+		bool labelGradient;
+		bool discreteVoronoi;
+		bool powerDiagram;
+		bool adaptiveDegree;
+		bool adaptiveSites;
+		bool freezeSites;
+		bool sampledFits;
 
 		bool showImage;
 		bool showSites;
@@ -1,4 +1,3 @@
-
 /**
 * author: Yanyang Xiao
 * email : yanyangxiaoxyy@gmail.com
@@ -7,41 +6,207 @@
 #ifndef PIXELSET_H
 #define PIXELSET_H
 
+#include <cstddef>
 #include <vector>
+#include <algorithm>
 
 namespace xyy
 {
+	/**
+	* pixels of one cell, row j in [ymin, ymax] covers left[j - ymin] ... right[j - ymin]
+	* a view into PixelSets, invalidated by any change of the storage
+	*/
 	struct PixelSet
 	{
-		std::vector<int> left;
-		std::vector<int> right;
+		const int *left;
+		const int *right;
 		int ymin;
 		int ymax;
 
 		PixelSet()
-			: ymin(1000000), ymax(-1)
+			: left(NULL), right(NULL), ymin(0), ymax(-1)
+		{
+		}
+
+		PixelSet(const int *l, const int *r, int y0, int y1)
+			: left(l), right(r), ymin(y0), ymax(y1)
 		{
 		}
 
-		PixelSet& operator= (const PixelSet& rhs)
+		int area() const
+		{
+			int count = 0;
+			for (int j = ymin; j <= ymax; ++j)
+			{
+				int loc = j - ymin;
+				if (right[loc] >= left[loc])
+					count += right[loc] - left[loc] + 1;
+			}
+
+			return count;
+		}
+	};
+
+	/**
+	* stratified subset of a pixel set: pixel (i, j) is kept iff i + offsetX and j + offsetY are
+	* multiples of step, with offsets uniform in [0, step) sums over it times step^2 are unbiased
+	*/
+	struct PixelSample
+	{
+		int step;
+		int offsetX;
+		int offsetY;
+
+		PixelSample()
+			: step(1), offsetX(0), offsetY(0)
 		{
-			ymin = rhs.ymin;
-			ymax = rhs.ymax;
-			left = rhs.left;
-			right = rhs.right;
+		}
 
-			return *this;
+		PixelSample(int s, int x, int y)
+			: step(s), offsetX(x), offsetY(y)
+		{
 		}
+	};
+
+	// the kept pixels of row j are n, every step-th from column first on, a NULL sample keeps all
+	inline int sampled_span(const PixelSet *pixels, const PixelSample *sample, int j, int &first)
+	{
+		int loc = j - pixels->ymin;
+		int left = pixels->left[loc];
+		int right = pixels->right[loc];
 
+		first = left;
+		if (!sample || sample->step == 1)
+			return right - left + 1;
+
+		int step = sample->step;
+		if ((j + sample->offsetY) % step != 0 || right < left)
+			return 0;
+
+		first = left + (step - (left + sample->offsetX) % step) % step;
+		return first <= right ? (right - first) / step + 1 : 0;
+	}
+
+	/**
+	* spans of all cells in one buffer, set v owns rows [_start[v], _start[v] + _ymax[v] - _ymin[v]]
+	* a rebuilt set is appended at the end, the stale rows are reclaimed by compact()
+	*/
+	class PixelSets
+	{
+	private:
+		std::vector<int> _ymin;
+		std::vector<int> _ymax;
+		std::vector<int> _start;
+		std::vector<int> _left;
+		std::vector<int> _right;
+		int              _garbage;
+
+		// compact() builds into these and swaps, so capacity survives
+		std::vector<int> _tempLeft;
+		std::vector<int> _tempRight;
+
+	public:
+		PixelSets()
+			: _garbage(0)
+		{
+		}
+
+		// keeps capacity
 		void clear()
 		{
-			ymin = 1000000;
-			ymax = -1;
-			left.clear();
-			right.clear();
+			_ymin.clear();
+			_ymax.clear();
+			_start.clear();
+			_left.clear();
+			_right.clear();
+			_garbage = 0;
+		}
+
+		int sets_number() const
+		{
+			return (int)_start.size();
+		}
+
+		bool empty() const
+		{
+			return _start.empty();
+		}
+
+		// new sets are empty
+		void resize(int n)
+		{
+			_ymin.resize(n, 0);
+			_ymax.resize(n, -1);
+			_start.resize(n, rows_number());
+		}
+
+		int add_set()
+		{
+			resize(sets_number() + 1);
+			return sets_number() - 1;
+		}
+
+		int rows_number() const
+		{
+			return (int)_left.size();
+		}
+
+		// rows no longer referenced by any set
+		int garbage() const
+		{
+			return _garbage;
+		}
+
+		// (re)allocate rows [ymin, ymax] of set v at the end, left / right are left uninitialized
+		void set_rows(int v, int ymin, int ymax)
+		{
+			_garbage += (std::max)(0, _ymax[v] - _ymin[v] + 1);
+
+			_ymin[v] = ymin;
+			_ymax[v] = ymax;
+			_start[v] = rows_number();
+
+			int rows = (std::max)(0, ymax - ymin + 1);
+			_left.resize(_left.size() + rows);
+			_right.resize(_right.size() + rows);
+		}
+
+		int ymin(int v) const { return _ymin[v]; }
+		int ymax(int v) const { return _ymax[v]; }
+		int* left(int v) { return _left.empty() ? NULL : &_left[0] + _start[v]; }
+		int* right(int v) { return _right.empty() ? NULL : &_right[0] + _start[v]; }
+
+		PixelSet operator[] (int v) const
+		{
+			if (_left.empty())
+				return PixelSet(NULL, NULL, _ymin[v], _ymax[v]);
+
+			return PixelSet(&_left[0] + _start[v], &_right[0] + _start[v], _ymin[v], _ymax[v]);
+		}
+
+		// drop the stale rows left by rebuilt sets, sets are laid out in index order
+		void compact()
+		{
+			_tempLeft.clear();
+			_tempRight.clear();
+
+			int n = sets_number();
+			for (int v = 0; v < n; ++v)
+			{
+				int rows = (std::max)(0, _ymax[v] - _ymin[v] + 1);
+				int start = (int)_tempLeft.size();
+
+				_tempLeft.insert(_tempLeft.end(), _left.begin() + _start[v], _left.begin() + _start[v] + rows);
+				_tempRight.insert(_tempRight.end(), _right.begin() + _start[v], _right.begin() + _start[v] + rows);
+
+				_start[v] = start;
+			}
+
+			_left.swap(_tempLeft);
+			_right.swap(_tempRight);
+			_garbage = 0;
 		}
 	};
 }
 
 #endif
-
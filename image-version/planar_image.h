@@ -0,0 +1,82 @@
+
+/**
+* author: Yanyang Xiao
+* email : yanyangxiaoxyy@gmail.com
+*/
+
+#ifndef PLANAR_IMAGE_H
+#define PLANAR_IMAGE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace xyy
+{
+	/**
+	* float copy of an interleaved 8-bit image, one plane per channel
+	* every row starts on a 32-byte boundary
+	*/
+	class PlanarImage
+	{
+	private:
+		std::vector<float> _buffer;
+		size_t             _offset;
+		int                _width;
+		int                _height;
+		int                _channel;
+		int                _stride;
+
+	public:
+		PlanarImage()
+			: _offset(0), _width(0), _height(0), _channel(0), _stride(0)
+		{ }
+
+		void set(const unsigned char *image, int width, int height, int channel)
+		{
+			_width = width;
+			_height = height;
+			_channel = channel;
+			_stride = (width + 7) / 8 * 8;
+
+			_buffer.resize(size_t(_stride) * height * channel + 8);
+
+			size_t address = reinterpret_cast<size_t>(&_buffer[0]);
+			_offset = ((32 - (address & 31)) & 31) / sizeof(float);
+
+#pragma omp parallel for
+			for (int j = 0; j < height; ++j)
+			{
+				const unsigned char *src = &image[size_t(j) * width * channel];
+				for (int c = 0; c < channel; ++c)
+				{
+					float *dst = row(c, j);
+					for (int i = 0; i < width; ++i)
+						dst[i] = float(src[i * channel + c]);
+				}
+			}
+		}
+
+		void clear()
+		{
+			_buffer.clear();
+			_width = _height = _channel = _stride = 0;
+		}
+
+		bool empty() const { return _buffer.empty(); }
+		int width() const { return _width; }
+		int height() const { return _height; }
+		int channel() const { return _channel; }
+
+		float* row(int c, int j)
+		{
+			return &_buffer[_offset + (size_t(c) * _height + j) * _stride];
+		}
+
+		const float* row(int c, int j) const
+		{
+			return &_buffer[_offset + (size_t(c) * _height + j) * _stride];
+		}
+	};
+}
+
+#endif
@@ -9,42 +9,60 @@
 
 #include <vector>
 #include <math.h>
+#include <assert.h>
+#include <algorithm>
 #include <Eigen/Eigen>
 
 #include "pixelset.h"
+#include "legendre.h"
+#include "polynomial_kernels.h"
 
 namespace xyy
 {
+	/**
+	* one cell, degree <= Legendre::MaxDegree, channel <= 4
+	* tensor Legendre basis in the local coordinates of transform()
+	*/
 	template <typename Real>
 	class Polynomial
 	{
-		int tab[3] = { 1, 3, 6 };
+		enum { MaxCoefficients = 4 * Legendre::MaxTerms };
 
 	private:
 		int                 _degree;
-		std::vector<Real>   _coeff;
+		Real                _coeff[MaxCoefficients];
+		Real                _transform[3]; // u = (x - t[0]) * t[2], v = (y - t[1]) * t[2]
 
 	public:
 		Polynomial(int d = 1)
 			: _degree(d)
-		{ }
+		{
+			std::fill(_coeff, _coeff + MaxCoefficients, Real(0.0));
+			reset_transform();
+		}
 
 		Polynomial(const Polynomial &rhs)
 		{
 			_degree = rhs._degree;
-			_coeff = rhs._coeff;
+			std::copy(rhs._coeff, rhs._coeff + MaxCoefficients, _coeff);
+			std::copy(rhs._transform, rhs._transform + 3, _transform);
 		}
 
 		Polynomial& operator= (const Polynomial &rhs)
 		{
 			_degree = rhs._degree;
-			_coeff = rhs._coeff;
+			std::copy(rhs._coeff, rhs._coeff + MaxCoefficients, _coeff);
+			std::copy(rhs._transform, rhs._transform + 3, _transform);
 
 			return *this;
 		}
 
 		int degree() const	{ return _degree; }
-		std::vector<Real>& coefficients() const { return _coeff; }
+		void set_degree(int d) { _degree = d; }
+
+		// channel major, Legendre::terms_number(_degree) terms per channel
+		const Real* coefficients() const { return _coeff; }
+		const Real* transform() const { return _transform; }
 
 		void compute_factors(
 			const unsigned char *image, 
@@ -68,6 +86,15 @@ namespace xyy
 			int Lp = 2) const;
 
 	protected:
+		void reset_transform()
+		{
+			_transform[0] = Real(0.0);
+			_transform[1] = Real(0.0);
+			_transform[2] = Real(1.0);
+		}
+
+		void monomials_to_legendre(int channel);
+
 		void compute_constant_factors(
 			const unsigned char *image,
 			int width,
@@ -101,6 +128,16 @@ namespace xyy
 		if (!image || !pixels)
 			return;
 
+		typename PolynomialKernels<Real>::Fit fit = PolynomialKernels<Real>::fit(_degree, channel);
+		if (fit)
+		{
+			fit(image, width, height, pixels, _coeff, _transform);
+			return;
+		}
+
+		// the runtime path fits monomials in global coordinates, degree <= 2
+		reset_transform();
+
 		switch (_degree)
 		{
 		case 1:
@@ -110,9 +147,46 @@ namespace xyy
 			compute_quadratic_factors(image, width, height, channel, pixels);
 			break;
 		default:
+			_degree = 0;
 			compute_constant_factors(image, width, height, channel, pixels);
 			break;
 		}
+
+		monomials_to_legendre(channel);
+	}
+
+	template <typename Real>
+	void Polynomial<Real>::monomials_to_legendre(int channel)
+	{
+		const double *M = Legendre::powers();
+		const int stride = Legendre::MaxDegree + 1;
+
+		int terms = Legendre::terms_number(_degree);
+		int ex[Legendre::MaxTerms], ey[Legendre::MaxTerms];
+		Legendre::exponents(_degree, ex, ey);
+
+		// monomials are ordered like the Legendre terms, x^ex[k] y^ey[k]
+		for (int c = 0; c < channel; ++c)
+		{
+			Real *coeff = &_coeff[c * terms];
+
+			Real m[Legendre::MaxTerms];
+			std::copy(coeff, coeff + terms, m);
+			std::fill(coeff, coeff + terms, Real(0.0));
+
+			for (int k = 0; k < terms; ++k)
+			{
+				for (int a = 0; a <= ex[k]; ++a)
+				{
+					for (int b = 0; b <= ey[k]; ++b)
+					{
+						double w = M[ex[k] * stride + a] * M[ey[k] * stride + b];
+						if (w != 0.0)
+							coeff[Legendre::index(_degree, a, b)] += m[k] * w;
+					}
+				}
+			}
+		}
 	}
 
 	template <typename Real>
@@ -123,8 +197,9 @@ namespace xyy
 		int channel,
 		const PixelSet* pixels)
 	{
-		_coeff.clear();
-		_coeff.resize(channel, Real(0.0));
+		assert(channel <= 4);
+
+		std::fill(_coeff, _coeff + channel, Real(0.0));
 
 		int count = 0;
 		for (int j = pixels->ymin; j <= pixels->ymax; ++j)
@@ -163,15 +238,14 @@ namespace xyy
 		int channel,
 		const PixelSet* pixels)
 	{
-		_coeff.clear();
-		_coeff.resize(channel * 3);
-
 		Real ratio = Real(height) / width;
 		Real pixWidth = Real(2.0) / width;
 		Real pixArea = pixWidth * pixWidth;
 
-		std::vector<Eigen::Matrix3d> matA(channel);
-		std::vector<Eigen::Vector3d> vecB(channel);
+		assert(channel <= 4);
+
+		Eigen::Matrix3d matA[4];
+		Eigen::Vector3d vecB[4];
 		for (int c = 0; c < channel; ++c)
 		{
 			matA[c].setZero();
@@ -240,20 +314,20 @@ namespace xyy
 		int channel,
 		const PixelSet* pixels)
 	{
-		_coeff.clear();
-		_coeff.resize(channel * 6);
-
 		Real ratio = Real(height) / width;
 		Real pixWidth = Real(2.0) / width;
 		Real pixArea = pixWidth * pixWidth;
 
-		Eigen::MatrixXd matA[3];
-		Eigen::VectorXd vecB[3];
+		assert(channel <= 4);
+
+		// fixed size, no heap allocation per cell
+		Eigen::Matrix<double, 6, 6> matA[4];
+		Eigen::Matrix<double, 6, 1> vecB[4];
 
 		for (int c = 0; c < channel; c++)
 		{
-			matA[c] = Eigen::MatrixXd::Zero(6, 6);
-			vecB[c] = Eigen::VectorXd::Zero(6);
+			matA[c].setZero();
+			vecB[c].setZero();
 		}
 
 		Real temp[6];
@@ -298,7 +372,7 @@ namespace xyy
 		{
 			if (matA[c].determinant() != Real(0.0))
 			{
-				Eigen::VectorXd vecX = matA[c].colPivHouseholderQr().solve(vecB[c]);
+				Eigen::Matrix<double, 6, 1> vecX = matA[c].colPivHouseholderQr().solve(vecB[c]);
 				for (int k = 0; k < 6; ++k)
 				{
 					_coeff[c * 6 + k] = vecX(k);
@@ -349,21 +423,20 @@ namespace xyy
 	template <typename Real>
 	Real Polynomial<Real>::evaluate(int c, Real x, Real y) const
 	{
-		Real result = Real(0.0);
+		x = (x - _transform[0]) * _transform[2];
+		y = (y - _transform[1]) * _transform[2];
 
-		switch (_degree)
-		{
-		case 0:
-			result = _coeff[c];
-			break;
-		case 1:
-			result = _coeff[c * 3] * x + _coeff[c * 3 + 1] * y + _coeff[c * 3 + 2];
-			break;
-		case 2:
-			result = _coeff[c * 6] * x * x + _coeff[c * 6 + 1] * x * y + _coeff[c * 6 + 2] * y * y
-				+ _coeff[c * 6 + 3] * x + _coeff[c * 6 + 4] * y + _coeff[c * 6 + 5];
-			break;
-		}
+		int terms = Legendre::terms_number(_degree);
+		int ex[Legendre::MaxTerms], ey[Legendre::MaxTerms];
+		Legendre::exponents(_degree, ex, ey);
+
+		Real pu[Legendre::MaxDegree + 1], pv[Legendre::MaxDegree + 1];
+		Legendre::values(_degree, x, pu);
+		Legendre::values(_degree, y, pv);
+
+		Real result = Real(0.0);
+		for (int k = 0; k < terms; ++k)
+			result += _coeff[c * terms + k] * pu[ex[k]] * pv[ey[k]];
 
 		return result;
 	}
@@ -375,11 +448,15 @@ namespace xyy
 		int height,
 		int channel,
 		const PixelSet* pixels,
-		int Lp = 2) const
+		int Lp) const
 	{
 		if (!image || !pixels)
 			return Real(0.0);
 
+		typename PolynomialKernels<Real>::Energy energy = PolynomialKernels<Real>::energy(_degree, channel);
+		if (energy)
+			return energy(_coeff, _transform, image, width, height, pixels, Lp);
+
 		Real ratio = Real(height) / width;
 		Real pixWidth = Real(2.0) / width;
 		Real pixArea = pixWidth * pixWidth;
@@ -403,7 +480,7 @@ namespace xyy
 				{
 					Real approxVal = evaluate(c, x, y);
 					Real pixVal = (Real)pixColor[c];
-					Real absError = abs(pixVal - approxVal);
+					Real absError = std::fabs(pixVal - approxVal);
 					tempEnergy += std::pow(absError, Lp);
 				}
 
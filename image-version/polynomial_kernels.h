@@ -0,0 +1,818 @@
+
+/**
+* author: Yanyang Xiao
+* email : yanyangxiaoxyy@gmail.com
+*/
+
+#ifndef POLYNOMIAL_KERNELS_H
+#define POLYNOMIAL_KERNELS_H
+
+#include <math.h>
+#include <algorithm>
+#include <Eigen/Eigen>
+
+#include "pixelset.h"
+#include "planar_image.h"
+#include "span_kernels.h"
+#include "legendre.h"
+
+namespace xyy
+{
+	// grows box = { xmin, xmax, ymin, ymax } by the pixels, start from { width, -1, height, -1 }
+	inline void cell_bounds(const PixelSet *pixels, int *box)
+	{
+		for (int j = pixels->ymin; j <= pixels->ymax; ++j)
+		{
+			int loc = j - pixels->ymin;
+			if (pixels->right[loc] < pixels->left[loc])
+				continue;
+
+			box[0] = (std::min)(box[0], pixels->left[loc]);
+			box[1] = (std::max)(box[1], pixels->right[loc]);
+			box[2] = (std::min)(box[2], j);
+			box[3] = (std::max)(box[3], j);
+		}
+	}
+
+	/**
+	* center and inverse half extent of a pixel box
+	* local coordinates u = (x - t[0]) * t[2], v = (y - t[1]) * t[2] stay in [-1, 1]
+	*/
+	template <typename Real>
+	void box_transform(const int *box, int width, int height, Real *t)
+	{
+		t[0] = Real(0.0);
+		t[1] = Real(0.0);
+		t[2] = Real(1.0);
+		if (box[1] < box[0])
+			return;
+
+		Real ratio = Real(height) / width;
+		Real pixWidth = Real(2.0) / width;
+
+		t[0] = pixWidth * (Real(0.5) * (box[0] + box[1]) + Real(0.5)) - Real(1.0);
+		t[1] = pixWidth * (Real(0.5) * (box[2] + box[3]) + Real(0.5)) - ratio;
+		t[2] = Real(2.0) / (pixWidth * ((std::max)(box[1] - box[0], box[3] - box[2]) + 1));
+	}
+
+	// box_transform of the bounding box of the pixel centers
+	template <typename Real>
+	void cell_transform(const PixelSet *pixels, int width, int height, Real *t)
+	{
+		int box[4] = { width, -1, height, -1 };
+		cell_bounds(pixels, box);
+		box_transform(box, width, height, t);
+	}
+
+	/**
+	* solve the normal equations on the trailing Size x Size block of the gram matrix
+	* the trailing terms are the lower degree ones, so a singular block falls back one degree
+	* in cell-local coordinates the gram matrix is well scaled, a plain Cholesky is enough
+	*/
+	template <typename Real, int Degree, int Terms, int Channel>
+	struct PolynomialSolve
+	{
+		enum { Size = (Degree + 1) * (Degree + 2) / 2 };
+
+		static void run(
+			const Eigen::Matrix<Real, Terms, Terms> &matA,
+			const Eigen::Matrix<Real, Terms, Channel> &matB,
+			Real *coeff)
+		{
+			Eigen::Matrix<Real, Size, Size> subA = matA.template bottomRightCorner<Size, Size>();
+			Eigen::LLT<Eigen::Matrix<Real, Size, Size> > llt(subA);
+
+			// rank deficient, e.g. a one-row cell for the y terms
+			Real pivot = llt.matrixLLT().diagonal().minCoeff();
+			if (llt.info() != Eigen::Success || !(pivot * pivot > Real(1e-10) * subA.diagonal().maxCoeff()))
+			{
+				PolynomialSolve<Real, Degree - 1, Terms, Channel>::run(matA, matB, coeff);
+				return;
+			}
+
+			Eigen::Matrix<Real, Size, Channel> subB = matB.template bottomRows<Size>();
+			Eigen::Matrix<Real, Size, Channel> subX = llt.solve(subB);
+
+			for (int c = 0; c < Channel; ++c)
+			{
+				for (int k = 0; k < Terms - Size; ++k)
+					coeff[c * Terms + k] = Real(0.0);
+
+				for (int k = 0; k < Size; ++k)
+					coeff[c * Terms + Terms - Size + k] = subX(k, c);
+			}
+		}
+	};
+
+	template <typename Real, int Terms, int Channel>
+	struct PolynomialSolve<Real, -1, Terms, Channel>
+	{
+		static void run(
+			const Eigen::Matrix<Real, Terms, Terms> &,
+			const Eigen::Matrix<Real, Terms, Channel> &,
+			Real *coeff)
+		{
+			for (int k = 0; k < Channel * Terms; ++k)
+				coeff[k] = Real(0.0);
+		}
+	};
+
+	// sum (f - p)^2 at a least squares solution
+	template <typename Real, int Terms, int Channel>
+	Real residual(const Eigen::Matrix<Real, Terms, Channel> &matB, Real sumF2, const Real *coeff)
+	{
+		Real energy = sumF2;
+		for (int c = 0; c < Channel; ++c)
+		{
+			for (int k = 0; k < Terms; ++k)
+				energy -= coeff[c * Terms + k] * matB(k, c);
+		}
+
+		return (std::max)(energy, Real(0.0));
+	}
+
+	/**
+	* least squares energy of every degree <= Degree from one gram matrix
+	* at the solution of a trailing block, sum (f - p)^2 = sum f^2 - x . b
+	*/
+	template <typename Real, int Degree, int Terms, int Channel>
+	struct PolynomialEnergies
+	{
+		static void run(
+			const Eigen::Matrix<Real, Terms, Terms> &matA,
+			const Eigen::Matrix<Real, Terms, Channel> &matB,
+			Real sumF2,
+			Real *energies)
+		{
+			Real coeff[Channel * Terms];
+			PolynomialSolve<Real, Degree, Terms, Channel>::run(matA, matB, coeff);
+
+			energies[Degree] = residual(matB, sumF2, coeff);
+			PolynomialEnergies<Real, Degree - 1, Terms, Channel>::run(matA, matB, sumF2, energies);
+		}
+	};
+
+	template <typename Real, int Terms, int Channel>
+	struct PolynomialEnergies<Real, -1, Terms, Channel>
+	{
+		static void run(
+			const Eigen::Matrix<Real, Terms, Terms> &,
+			const Eigen::Matrix<Real, Terms, Channel> &,
+			Real,
+			Real *)
+		{ }
+	};
+
+	/**
+	* raise the degree from 0 while one more degree removes more than cost per added coefficient
+	* energies[d] as filled by PolynomialEnergies, d <= maxDegree
+	*/
+	template <typename Real>
+	int select_degree(const Real *energies, int maxDegree, int channel, Real cost)
+	{
+		int degree = 0;
+		while (degree < maxDegree)
+		{
+			int added = channel * (Legendre::terms_number(degree + 1) - Legendre::terms_number(degree));
+			if (energies[degree] - energies[degree + 1] <= cost * added)
+				break;
+
+			++degree;
+		}
+
+		return degree;
+	}
+
+	/**
+	* fitting and energy of one cell with the degree and the channel count fixed at compile time
+	* Legendre basis and coefficient layout as Polynomial, in the local coordinates of cell_transform
+	*/
+	template <typename Real, int Degree, int Channel>
+	struct PolynomialKernel
+	{
+		enum { Terms = (Degree + 1) * (Degree + 2) / 2 };
+		enum { SampleChunk = 256 };
+
+		// restricted to row v, channel polynomial a is sum_p b[p] * u^p
+		static void row_polynomial(const Real *a, Real v, Real *b)
+		{
+			const double *L = Legendre::monomials();
+
+			int ex[Terms], ey[Terms];
+			Legendre::exponents(Degree, ex, ey);
+
+			Real pv[Degree + 1];
+			Legendre::values(Degree, v, pv);
+
+			for (int p = 0; p <= Degree; ++p)
+				b[p] = Real(0.0);
+
+			for (int k = 0; k < Terms; ++k)
+			{
+				Real w = a[k] * pv[ey[k]];
+				for (int p = 0; p <= ex[k]; ++p)
+					b[p] += w * L[ex[k] * (Legendre::MaxDegree + 1) + p];
+			}
+		}
+
+		static Real horner(const Real *b, Real u)
+		{
+			Real result = b[Degree];
+			for (int p = Degree - 1; p >= 0; --p)
+				result = result * u + b[p];
+
+			return result;
+		}
+
+		static void fit(
+			const unsigned char *image,
+			int width,
+			int height,
+			const PixelSet *pixels,
+			Real *coeff,
+			Real *transform)
+		{
+			Real ratio = Real(height) / width;
+			Real pixWidth = Real(2.0) / width;
+			Real pixArea = pixWidth * pixWidth;
+
+			cell_transform(pixels, width, height, transform);
+			Real scale = transform[2];
+
+			int ex[Terms], ey[Terms];
+			Legendre::exponents(Degree, ex, ey);
+
+			// the gram matrix does not depend on the channel, one solve with Channel right-hand sides
+			Eigen::Matrix<Real, Terms, Terms> matA;
+			Eigen::Matrix<Real, Terms, Channel> matB;
+			matA.setZero();
+			matB.setZero();
+
+			Real pu[Degree + 1], pv[Degree + 1], t[Terms];
+			for (int j = pixels->ymin; j <= pixels->ymax; ++j)
+			{
+				Real y = (pixWidth * (j + Real(0.5)) - ratio - transform[1]) * scale;
+				Legendre::values(Degree, y, pv);
+
+				int lineStart = j * width;
+
+				int loc = j - pixels->ymin;
+				for (int i = pixels->left[loc]; i <= pixels->right[loc]; ++i)
+				{
+					Real x = (pixWidth * (i + Real(0.5)) - Real(1.0) - transform[0]) * scale;
+					const unsigned char *pixColor = &image[Channel * (lineStart + i)];
+
+					Legendre::values(Degree, x, pu);
+					for (int k = 0; k < Terms; ++k)
+						t[k] = pu[ex[k]] * pv[ey[k]];
+
+					for (int k = 0; k < Terms; ++k)
+					{
+						for (int l = k; l < Terms; ++l)
+							matA(k, l) += t[k] * t[l];
+
+						for (int c = 0; c < Channel; ++c)
+							matB(k, c) += t[k] * pixColor[c];
+					}
+				}
+			}
+
+			for (int k = 0; k < Terms; ++k)
+			{
+				for (int l = 0; l < k; ++l)
+					matA(k, l) = matA(l, k);
+			}
+
+			matA *= pixArea;
+			matB *= pixArea;
+
+			PolynomialSolve<Real, Degree, Terms, Channel>::run(matA, matB, coeff);
+		}
+
+		static Real energy(
+			const Real *coeff,
+			const Real *transform,
+			const unsigned char *image,
+			int width,
+			int height,
+			const PixelSet *pixels,
+			int Lp)
+		{
+			Real ratio = Real(height) / width;
+			Real pixWidth = Real(2.0) / width;
+			Real pixArea = pixWidth * pixWidth;
+			Real scale = transform[2];
+
+			Real result = Real(0.0);
+			for (int j = pixels->ymin; j <= pixels->ymax; ++j)
+			{
+				Real y = (pixWidth * (j + Real(0.5)) - ratio - transform[1]) * scale;
+				int lineStart = j * width;
+
+				Real b[Channel][Degree + 1];
+				for (int c = 0; c < Channel; ++c)
+					row_polynomial(&coeff[c * Terms], y, b[c]);
+
+				int loc = j - pixels->ymin;
+				Real sum = Real(0.0);
+				for (int i = pixels->left[loc]; i <= pixels->right[loc]; ++i)
+				{
+					Real x = (pixWidth * (i + Real(0.5)) - Real(1.0) - transform[0]) * scale;
+					const unsigned char *pixColor = &image[Channel * (lineStart + i)];
+
+					for (int c = 0; c < Channel; ++c)
+					{
+						Real diff = Real(pixColor[c]) - horner(b[c], x);
+						sum += (Lp == 2 ? diff * diff : std::pow(std::fabs(diff), Lp));
+					}
+				}
+
+				result += sum * pixArea;
+			}
+
+			return result;
+		}
+
+		// same as fit, assembled from per-row moments of the float planes
+		static void fit_planar(
+			const PlanarImage &image,
+			const PixelSet *pixels,
+			Real *coeff,
+			Real *transform)
+		{
+			fit_sampled(image, pixels, NULL, coeff, transform);
+		}
+
+		// fit_planar on the pixels of sample, the frame is still the box of all pixels
+		static void fit_sampled(
+			const PlanarImage &image,
+			const PixelSet *pixels,
+			const PixelSample *sample,
+			Real *coeff,
+			Real *transform)
+		{
+			cell_transform(pixels, image.width(), image.height(), transform);
+
+			Eigen::Matrix<Real, Terms, Terms> matA;
+			Eigen::Matrix<Real, Terms, Channel> matB;
+			matA.setZero();
+			matB.setZero();
+
+			accumulate_planar(image, pixels, transform, matA, matB, NULL, sample);
+			finish_planar(image, matA, matB);
+
+			PolynomialSolve<Real, Degree, Terms, Channel>::run(matA, matB, coeff);
+		}
+
+		/**
+		* fit_planar for the degree picked by select_degree among 0 ... Degree
+		* coeff is laid out for the picked degree, the energies of all of them come from the same gram matrix
+		*/
+		static void fit_adaptive(
+			const PlanarImage &image,
+			const PixelSet *pixels,
+			Real cost,
+			Real *coeff,
+			Real *transform,
+			int *degree)
+		{
+			cell_transform(pixels, image.width(), image.height(), transform);
+
+			Eigen::Matrix<Real, Terms, Terms> matA;
+			Eigen::Matrix<Real, Terms, Channel> matB;
+			matA.setZero();
+			matB.setZero();
+
+			double f2 = 0.0;
+			accumulate_planar(image, pixels, transform, matA, matB, &f2);
+			Real sumF2 = finish_planar(image, matA, matB, f2);
+
+			Real energies[Degree + 1];
+			PolynomialEnergies<Real, Degree, Terms, Channel>::run(matA, matB, sumF2, energies);
+
+			int d = select_degree(energies, Degree, Channel, cost);
+
+			Real full[Channel * Terms];
+			solve(d, matA, matB, full);
+
+			// keep the trailing block of the picked degree
+			int terms = Legendre::terms_number(d);
+			for (int c = 0; c < Channel; ++c)
+			{
+				for (int k = 0; k < terms; ++k)
+					coeff[c * terms + k] = full[c * Terms + Terms - terms + k];
+			}
+
+			*degree = d;
+		}
+
+		// energy of one fit_planar over the pixels of both cells, in the frame of their common box
+		static Real union_energy(
+			const PlanarImage &image,
+			const PixelSet *a,
+			const PixelSet *b)
+		{
+			int box[4] = { image.width(), -1, image.height(), -1 };
+			cell_bounds(a, box);
+			cell_bounds(b, box);
+
+			Real transform[3];
+			box_transform(box, image.width(), image.height(), transform);
+
+			Eigen::Matrix<Real, Terms, Terms> matA;
+			Eigen::Matrix<Real, Terms, Channel> matB;
+			matA.setZero();
+			matB.setZero();
+
+			// the sums of disjoint pixel sets add up
+			double f2 = 0.0;
+			accumulate_planar(image, a, transform, matA, matB, &f2);
+			accumulate_planar(image, b, transform, matA, matB, &f2);
+			Real sumF2 = finish_planar(image, matA, matB, f2);
+
+			Real coeff[Channel * Terms];
+			PolynomialSolve<Real, Degree, Terms, Channel>::run(matA, matB, coeff);
+
+			return residual(matB, sumF2, coeff);
+		}
+
+		/**
+		* adds the upper triangle of the gram matrix, the right-hand sides and sum f^2 (if f2)
+		* of the pixels in the frame of transform, finish_planar completes them
+		* with a sample only its pixels are summed, each counting for step^2 pixels
+		*/
+		static void accumulate_planar(
+			const PlanarImage &image,
+			const PixelSet *pixels,
+			const Real *transform,
+			Eigen::Matrix<Real, Terms, Terms> &matA,
+			Eigen::Matrix<Real, Terms, Channel> &matB,
+			double *f2,
+			const PixelSample *sample = NULL)
+		{
+			const SpanKernels &kernels = span_kernels();
+			const double *L = Legendre::monomials();
+			const int stride = Legendre::MaxDegree + 1;
+
+			Real ratio = Real(image.height()) / image.width();
+			Real pixWidth = Real(2.0) / image.width();
+
+			Real scale = transform[2];
+			int step = sample ? sample->step : 1;
+			Real du = pixWidth * scale * step;
+			double weight = double(step) * step;
+
+			int ex[Terms], ey[Terms];
+			Legendre::exponents(Degree, ex, ey);
+
+			for (int j = pixels->ymin; j <= pixels->ymax; ++j)
+			{
+				int left;
+				int n = sampled_span(pixels, sample, j, left);
+				if (n <= 0)
+					continue;
+
+				Real y = (pixWidth * (j + Real(0.5)) - ratio - transform[1]) * scale;
+				Real x0 = (pixWidth * (left + Real(0.5)) - Real(1.0) - transform[0]) * scale;
+
+				// sum u^p and sum f u^p of the span
+				double sx[2 * Degree + 1] = { 0.0 };
+				kernels.powers(n, x0, du, sx, 2 * Degree);
+
+				double sf[Channel][Degree + 1] = { { 0.0 } };
+				double rowF2 = 0.0;
+				for (int c = 0; c < Channel; ++c)
+					strided_moments(image.row(c, j) + left, n, step, x0, du, sf[c], f2 ? &rowF2 : NULL);
+
+				if (step > 1)
+				{
+					for (int p = 0; p <= 2 * Degree; ++p)
+						sx[p] *= weight;
+
+					for (int c = 0; c < Channel; ++c)
+					{
+						for (int p = 0; p <= Degree; ++p)
+							sf[c][p] *= weight;
+					}
+				}
+
+				if (f2)
+					*f2 += weight * rowF2;
+
+				// the same sums for P_a(u) P_b(u) and f P_a(u)
+				Real lx[Degree + 1][Degree + 1];
+				for (int a = 0; a <= Degree; ++a)
+				{
+					for (int b = a; b <= Degree; ++b)
+					{
+						Real sum = Real(0.0);
+						for (int p = 0; p <= a; ++p)
+						{
+							for (int q = 0; q <= b; ++q)
+								sum += L[a * stride + p] * L[b * stride + q] * sx[p + q];
+						}
+
+						lx[a][b] = lx[b][a] = sum;
+					}
+				}
+
+				Real lf[Channel][Degree + 1];
+				for (int c = 0; c < Channel; ++c)
+				{
+					for (int a = 0; a <= Degree; ++a)
+					{
+						Real sum = Real(0.0);
+						for (int p = 0; p <= a; ++p)
+							sum += L[a * stride + p] * sf[c][p];
+
+						lf[c][a] = sum;
+					}
+				}
+
+				Real pv[Degree + 1];
+				Legendre::values(Degree, y, pv);
+
+				for (int k = 0; k < Terms; ++k)
+				{
+					for (int l = k; l < Terms; ++l)
+						matA(k, l) += lx[ex[k]][ex[l]] * pv[ey[k]] * pv[ey[l]];
+
+					for (int c = 0; c < Channel; ++c)
+						matB(k, c) += lf[c][ex[k]] * pv[ey[k]];
+				}
+			}
+
+		}
+
+		// fills the lower triangle and scales by the pixel area, returns sum f^2 scaled the same way
+		static Real finish_planar(
+			const PlanarImage &image,
+			Eigen::Matrix<Real, Terms, Terms> &matA,
+			Eigen::Matrix<Real, Terms, Channel> &matB,
+			double f2 = 0.0)
+		{
+			Real pixWidth = Real(2.0) / image.width();
+			Real pixArea = pixWidth * pixWidth;
+
+			for (int k = 0; k < Terms; ++k)
+			{
+				for (int l = 0; l < k; ++l)
+					matA(k, l) = matA(l, k);
+			}
+
+			matA *= pixArea;
+			matB *= pixArea;
+
+			return Real(f2) * pixArea;
+		}
+
+		// PolynomialSolve with the degree picked at run time
+		static void solve(
+			int degree,
+			const Eigen::Matrix<Real, Terms, Terms> &matA,
+			const Eigen::Matrix<Real, Terms, Channel> &matB,
+			Real *coeff)
+		{
+			switch (degree)
+			{
+			case 4: PolynomialSolve<Real, (Degree < 4 ? Degree : 4), Terms, Channel>::run(matA, matB, coeff); break;
+			case 3: PolynomialSolve<Real, (Degree < 3 ? Degree : 3), Terms, Channel>::run(matA, matB, coeff); break;
+			case 2: PolynomialSolve<Real, (Degree < 2 ? Degree : 2), Terms, Channel>::run(matA, matB, coeff); break;
+			case 1: PolynomialSolve<Real, (Degree < 1 ? Degree : 1), Terms, Channel>::run(matA, matB, coeff); break;
+			default: PolynomialSolve<Real, 0, Terms, Channel>::run(matA, matB, coeff); break;
+			}
+		}
+
+		static Real energy_planar(
+			const Real *coeff,
+			const Real *transform,
+			const PlanarImage &image,
+			const PixelSet *pixels,
+			int Lp)
+		{
+			return energy_sampled(coeff, transform, image, pixels, NULL, Lp);
+		}
+
+		// energy_planar estimated from the pixels of sample, each counting for step^2 pixels
+		static Real energy_sampled(
+			const Real *coeff,
+			const Real *transform,
+			const PlanarImage &image,
+			const PixelSet *pixels,
+			const PixelSample *sample,
+			int Lp)
+		{
+			const SpanKernels &kernels = span_kernels();
+
+			Real ratio = Real(image.height()) / image.width();
+			Real pixWidth = Real(2.0) / image.width();
+			Real scale = transform[2];
+			int step = sample ? sample->step : 1;
+			Real du = pixWidth * scale * step;
+			Real pixArea = pixWidth * pixWidth * step * step;
+
+			// strided values are copied out in chunks for the span kernel
+			float buffer[SampleChunk];
+
+			Real result = Real(0.0);
+			for (int j = pixels->ymin; j <= pixels->ymax; ++j)
+			{
+				int left;
+				int n = sampled_span(pixels, sample, j, left);
+				if (n <= 0)
+					continue;
+
+				Real y = (pixWidth * (j + Real(0.5)) - ratio - transform[1]) * scale;
+				Real x0 = (pixWidth * (left + Real(0.5)) - Real(1.0) - transform[0]) * scale;
+
+				Real sum = Real(0.0);
+				for (int c = 0; c < Channel; ++c)
+				{
+					Real b[Degree + 1];
+					row_polynomial(&coeff[c * Terms], y, b);
+
+					const float *f = image.row(c, j) + left;
+					if (Lp != 2)
+					{
+						for (int i = 0; i < n; ++i)
+							sum += std::pow(std::fabs(f[i * step] - horner(b, x0 + i * du)), Lp);
+						continue;
+					}
+
+					if (step == 1)
+					{
+						sum += kernels.energy(f, n, x0, du, b, Degree);
+						continue;
+					}
+
+					for (int start = 0; start < n; start += SampleChunk)
+					{
+						int m = (std::min)(int(SampleChunk), n - start);
+						for (int i = 0; i < m; ++i)
+							buffer[i] = f[(start + i) * step];
+
+						sum += kernels.energy(buffer, m, x0 + start * du, du, b, Degree);
+					}
+				}
+
+				result += sum * pixArea;
+			}
+
+			return result;
+		}
+
+		/**
+		* s[p] += sum f * u^p and f2 (if given) += sum f^2 over f[0], f[step] ... f[(n - 1) * step],
+		* u = x0 + i * du, strided values are copied out in chunks for the span kernels
+		*/
+		static void strided_moments(const float *f, int n, int step, double x0, double du, double *s, double *f2)
+		{
+			const SpanKernels &kernels = span_kernels();
+			double zero = 0.0;
+
+			if (step == 1)
+			{
+				kernels.moments(f, n, x0, du, s, Degree);
+
+				// sum f^2, the residual of the zero polynomial
+				if (f2)
+					*f2 += kernels.energy(f, n, x0, du, &zero, 0);
+				return;
+			}
+
+			float buffer[SampleChunk];
+			for (int start = 0; start < n; start += SampleChunk)
+			{
+				int m = (std::min)(int(SampleChunk), n - start);
+				for (int i = 0; i < m; ++i)
+					buffer[i] = f[(start + i) * step];
+
+				kernels.moments(buffer, m, x0 + start * du, du, s, Degree);
+				if (f2)
+					*f2 += kernels.energy(buffer, m, x0 + start * du, du, &zero, 0);
+			}
+		}
+	};
+
+	/**
+	* picks the specialized kernels once per stage, NULL for combinations without one
+	*/
+	template <typename Real>
+	struct PolynomialKernels
+	{
+		typedef void (*Fit)(const unsigned char *, int, int, const PixelSet *, Real *, Real *);
+		typedef Real (*Energy)(const Real *, const Real *, const unsigned char *, int, int, const PixelSet *, int);
+		typedef void (*FitPlanar)(const PlanarImage &, const PixelSet *, Real *, Real *);
+		typedef Real (*EnergyPlanar)(const Real *, const Real *, const PlanarImage &, const PixelSet *, int);
+		typedef void (*FitSampled)(const PlanarImage &, const PixelSet *, const PixelSample *, Real *, Real *);
+		typedef Real (*EnergySampled)(const Real *, const Real *, const PlanarImage &, const PixelSet *, const PixelSample *, int);
+		typedef void (*FitAdaptive)(const PlanarImage &, const PixelSet *, Real, Real *, Real *, int *);
+		typedef Real (*UnionEnergy)(const PlanarImage &, const PixelSet *, const PixelSet *);
+
+		struct Functions
+		{
+			Fit           fit;
+			Energy        energy;
+			FitPlanar     fitPlanar;
+			EnergyPlanar  energyPlanar;
+			FitSampled    fitSampled;
+			EnergySampled energySampled;
+			FitAdaptive   fitAdaptive;
+			UnionEnergy   unionEnergy;
+		};
+
+		static Fit fit(int degree, int channel)
+		{
+			Functions f;
+			return lookup(degree, channel, f) ? f.fit : NULL;
+		}
+
+		static Energy energy(int degree, int channel)
+		{
+			Functions f;
+			return lookup(degree, channel, f) ? f.energy : NULL;
+		}
+
+		static FitPlanar fit_planar(int degree, int channel)
+		{
+			Functions f;
+			return lookup(degree, channel, f) ? f.fitPlanar : NULL;
+		}
+
+		static EnergyPlanar energy_planar(int degree, int channel)
+		{
+			Functions f;
+			return lookup(degree, channel, f) ? f.energyPlanar : NULL;
+		}
+
+		static FitSampled fit_sampled(int degree, int channel)
+		{
+			Functions f;
+			return lookup(degree, channel, f) ? f.fitSampled : NULL;
+		}
+
+		static EnergySampled energy_sampled(int degree, int channel)
+		{
+			Functions f;
+			return lookup(degree, channel, f) ? f.energySampled : NULL;
+		}
+
+		// chooses among degrees 0 ... degree
+		static FitAdaptive fit_adaptive(int degree, int channel)
+		{
+			Functions f;
+			return lookup(degree, channel, f) ? f.fitAdaptive : NULL;
+		}
+
+		static UnionEnergy union_energy(int degree, int channel)
+		{
+			Functions f;
+			return lookup(degree, channel, f) ? f.unionEnergy : NULL;
+		}
+
+	private:
+		template <int Degree, int Channel>
+		static bool entry(Functions &f)
+		{
+			typedef PolynomialKernel<Real, Degree, Channel> Kernel;
+
+			f.fit = &Kernel::fit;
+			f.energy = &Kernel::energy;
+			f.fitPlanar = &Kernel::fit_planar;
+			f.energyPlanar = &Kernel::energy_planar;
+			f.fitSampled = &Kernel::fit_sampled;
+			f.energySampled = &Kernel::energy_sampled;
+			f.fitAdaptive = &Kernel::fit_adaptive;
+			f.unionEnergy = &Kernel::union_energy;
+			return true;
+		}
+
+		template <int Degree>
+		static bool lookup(int channel, Functions &f)
+		{
+			switch (channel)
+			{
+			case 1: return entry<Degree, 1>(f);
+			case 2: return entry<Degree, 2>(f);
+			case 3: return entry<Degree, 3>(f);
+			case 4: return entry<Degree, 4>(f);
+			default: return false;
+			}
+		}
+
+		static bool lookup(int degree, int channel, Functions &f)
+		{
+			switch (degree)
+			{
+			case 0: return lookup<0>(channel, f);
+			case 1: return lookup<1>(channel, f);
+			case 2: return lookup<2>(channel, f);
+			case 3: return lookup<3>(channel, f);
+			case 4: return lookup<4>(channel, f);
+			default: return false;
+			}
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,374 @@
+
+/**
+* author: Yanyang Xiao
+* email : yanyangxiaoxyy@gmail.com
+*/
+
+#ifndef POLYNOMIAL_TABLE_H
+#define POLYNOMIAL_TABLE_H
+
+#include <vector>
+#include <math.h>
+#include <assert.h>
+#include <algorithm>
+
+#include "pixelset.h"
+#include "legendre.h"
+
+namespace xyy
+{
+	/**
+	* coefficients of all cells, structure of arrays
+	* term k of channel c of cell v is _coeff[(c * _terms + k) * _capacity + v]
+	* terms follow Polynomial, the Legendre basis in the local coordinates of each cell
+	* u = (x - _centerX[v]) * _scale[v], same for y
+	* rows are laid out for the highest degree, a cell of lower degree _degrees[v] keeps
+	* its terms in the trailing rows and zeros in the leading ones
+	*/
+	template <typename Real>
+	class PolynomialTable
+	{
+	private:
+		int                 _degree;
+		int                 _channel;
+		int                 _terms;
+		int                 _cells;
+		int                 _capacity;
+		std::vector<Real>   _coeff;
+		std::vector<Real>   _centerX;
+		std::vector<Real>   _centerY;
+		std::vector<Real>   _scale;
+		std::vector<int>    _degrees;
+
+	public:
+		PolynomialTable()
+			: _degree(0), _channel(0), _terms(1), _cells(0), _capacity(0)
+		{ }
+
+		int degree() const { return _degree; }
+		int channel() const { return _channel; }
+		int terms() const { return _terms; }
+		int degree(int v) const { return _degrees[v]; }
+		int terms(int v) const { return Legendre::terms_number(_degrees[v]); }
+		int cells_number() const { return _cells; }
+		bool empty() const { return _cells == 0; }
+
+		// coefficients are reset when the layout changes
+		void set_layout(int degree, int channel)
+		{
+			if (degree == _degree && channel == _channel)
+				return;
+
+			_degree = degree;
+			_channel = channel;
+			_terms = Legendre::terms_number(degree);
+			_coeff.assign(_channel * _terms * _capacity, Real(0.0));
+			std::fill(_degrees.begin(), _degrees.end(), _degree);
+		}
+
+		// stored coefficients over all cells and channels
+		int coefficients_number() const
+		{
+			int sum = 0;
+			for (int v = 0; v < _cells; ++v)
+				sum += terms(v);
+
+			return sum * _channel;
+		}
+
+		// keeps the coefficients of the first min(n, cells_number()) cells
+		void resize(int n)
+		{
+			if (n > _capacity)
+				reserve((std::max)(n, 2 * _capacity));
+
+			for (int r = 0; r < _channel * _terms; ++r)
+			{
+				for (int v = _cells; v < n; ++v)
+					_coeff[r * _capacity + v] = Real(0.0);
+			}
+
+			_centerX.resize(n, Real(0.0));
+			_centerY.resize(n, Real(0.0));
+			_scale.resize(n, Real(1.0));
+			_degrees.resize(n, _degree);
+
+			_cells = n;
+		}
+
+		int add_cell()
+		{
+			resize(_cells + 1);
+			return _cells - 1;
+		}
+
+		// the last cell takes over index v, as DelaunayTriangulation2D::remove_vertex
+		void remove_cell(int v)
+		{
+			int last = _cells - 1;
+			for (int r = 0; r < _channel * _terms; ++r)
+				_coeff[r * _capacity + v] = _coeff[r * _capacity + last];
+
+			_centerX[v] = _centerX[last];
+			_centerY[v] = _centerY[last];
+			_scale[v] = _scale[last];
+			_degrees[v] = _degrees[last];
+
+			resize(last);
+		}
+
+		// laid out as Polynomial::coefficients() and Polynomial::transform() of the given degree
+		void set(int v, const Real *coeff, const Real *transform, int degree)
+		{
+			assert(degree <= _degree);
+
+			int terms = Legendre::terms_number(degree);
+			int offset = _terms - terms;
+			for (int c = 0; c < _channel; ++c)
+			{
+				for (int k = 0; k < _terms; ++k)
+				{
+					Real a = k < offset ? Real(0.0) : coeff[c * terms + k - offset];
+					_coeff[(c * _terms + k) * _capacity + v] = a;
+				}
+			}
+
+			_degrees[v] = degree;
+
+			_centerX[v] = transform[0];
+			_centerY[v] = transform[1];
+			_scale[v] = transform[2];
+		}
+
+		void set(int v, const Real *coeff, const Real *transform)
+		{
+			set(v, coeff, transform, _degree);
+		}
+
+		// in the layout of degree(v)
+		void get(int v, Real *coeff, Real *transform) const
+		{
+			int terms = this->terms(v);
+			int offset = _terms - terms;
+			for (int c = 0; c < _channel; ++c)
+			{
+				for (int k = 0; k < terms; ++k)
+					coeff[c * terms + k] = _coeff[(c * _terms + offset + k) * _capacity + v];
+			}
+
+			transform[0] = _centerX[v];
+			transform[1] = _centerY[v];
+			transform[2] = _scale[v];
+		}
+
+		Real local_x(int v, Real x) const { return (x - _centerX[v]) * _scale[v]; }
+		Real local_y(int v, Real y) const { return (y - _centerY[v]) * _scale[v]; }
+		Real scale(int v) const { return _scale[v]; }
+
+		Real coefficient(int v, int c, int k) const
+		{
+			return _coeff[(c * _terms + k) * _capacity + v];
+		}
+
+		Real evaluate(int v, int c, Real x, Real y) const
+		{
+			Real a[Legendre::MaxTerms];
+			cell_coefficients(v, c, a);
+
+			return evaluate_local(a, _degrees[v], local_x(v, x), local_y(v, y));
+		}
+
+		// out[i] = f_cells[i](x[i], y[i]) on channel c
+		void evaluate(int c, int n, const int *cells, const Real *x, const Real *y, Real *out) const
+		{
+			const Real *a = channel_data(c);
+
+			int ex[Legendre::MaxTerms], ey[Legendre::MaxTerms];
+			Legendre::exponents(_degree, ex, ey);
+
+			Real pu[Legendre::MaxDegree + 1], pv[Legendre::MaxDegree + 1];
+			for (int i = 0; i < n; ++i)
+			{
+				int v = cells[i];
+				int d = _degrees[v];
+				Legendre::values(d, local_x(v, x[i]), pu);
+				Legendre::values(d, local_y(v, y[i]), pv);
+
+				Real sum = Real(0.0);
+				for (int k = _terms - Legendre::terms_number(d); k < _terms; ++k)
+					sum += a[k * _capacity + v] * pu[ex[k]] * pv[ey[k]];
+
+				out[i] = sum;
+			}
+		}
+
+		// out[i] = f_v(x[i], y[i]) on channel c
+		void evaluate(int v, int c, int n, const Real *x, const Real *y, Real *out) const
+		{
+			Real a[Legendre::MaxTerms];
+			cell_coefficients(v, c, a);
+
+			for (int i = 0; i < n; ++i)
+				out[i] = evaluate_local(a, _degrees[v], local_x(v, x[i]), local_y(v, y[i]));
+		}
+
+		// restricted to row y, f_v is sum_p b[p] * u^p on channel c, p <= degree(v), u = local_x(v, x)
+		void row_coefficients(int v, int c, Real y, Real *b) const
+		{
+			Real a[Legendre::MaxTerms];
+			cell_coefficients(v, c, a);
+
+			const double *L = Legendre::monomials();
+
+			int d = _degrees[v];
+			int ex[Legendre::MaxTerms], ey[Legendre::MaxTerms];
+			Legendre::exponents(d, ex, ey);
+
+			Real pv[Legendre::MaxDegree + 1];
+			Legendre::values(d, local_y(v, y), pv);
+
+			for (int p = 0; p <= d; ++p)
+				b[p] = Real(0.0);
+
+			int terms = Legendre::terms_number(d);
+			for (int k = 0; k < terms; ++k)
+			{
+				Real w = a[k] * pv[ey[k]];
+				for (int p = 0; p <= ex[k]; ++p)
+					b[p] += w * L[ex[k] * (Legendre::MaxDegree + 1) + p];
+			}
+		}
+
+		// out[i] = f_v(x0 + i * dx, y) on channel c, one span of a row
+		void evaluate_row(int v, int c, Real x0, Real dx, Real y, int n, Real *out) const
+		{
+			Real b[Legendre::MaxDegree + 1];
+			row_coefficients(v, c, y, b);
+
+			int d = _degrees[v];
+			Real u0 = local_x(v, x0), du = dx * _scale[v];
+			for (int i = 0; i < n; ++i)
+			{
+				Real u = u0 + i * du;
+
+				Real result = b[d];
+				for (int p = d - 1; p >= 0; --p)
+					result = result * u + b[p];
+
+				out[i] = result;
+			}
+		}
+
+		// same as Polynomial::compute_energy, evaluated in row chunks
+		Real compute_energy(
+			int v,
+			const unsigned char *image,
+			int width,
+			int height,
+			int channel,
+			const PixelSet* pixels,
+			int Lp = 2) const
+		{
+			if (!image || !pixels)
+				return Real(0.0);
+
+			const int chunk = 64;
+			Real values[chunk];
+
+			Real ratio = Real(height) / width;
+			Real pixWidth = Real(2.0) / width;
+			Real pixArea = pixWidth * pixWidth;
+
+			Real result = Real(0.0);
+			for (int j = pixels->ymin; j <= pixels->ymax; ++j)
+			{
+				Real y = pixWidth * (j + Real(0.5)) - ratio;
+				int lineStart = j * width;
+
+				int loc = j - pixels->ymin;
+				for (int i0 = pixels->left[loc]; i0 <= pixels->right[loc]; i0 += chunk)
+				{
+					int n = (std::min)(chunk, pixels->right[loc] - i0 + 1);
+					Real x0 = pixWidth * (i0 + Real(0.5)) - Real(1.0);
+					const unsigned char *pixColor = &image[channel * (lineStart + i0)];
+
+					for (int c = 0; c < channel; ++c)
+					{
+						evaluate_row(v, c, x0, pixWidth, y, n, values);
+
+						Real sum = Real(0.0);
+						if (Lp == 2)
+						{
+							for (int i = 0; i < n; ++i)
+							{
+								Real diff = Real(pixColor[channel * i + c]) - values[i];
+								sum += diff * diff;
+							}
+						}
+						else
+						{
+							for (int i = 0; i < n; ++i)
+								sum += std::pow(std::fabs(Real(pixColor[channel * i + c]) - values[i]), Lp);
+						}
+
+						result += sum * pixArea;
+					}
+				}
+			}
+
+			return result;
+		}
+
+	protected:
+		const Real* channel_data(int c) const
+		{
+			return _coeff.empty() ? NULL : &_coeff[c * _terms * _capacity];
+		}
+
+		// a holds the terms_number(degree) coefficients of that degree
+		Real evaluate_local(const Real *a, int degree, Real u, Real w) const
+		{
+			int ex[Legendre::MaxTerms], ey[Legendre::MaxTerms];
+			Legendre::exponents(degree, ex, ey);
+
+			Real pu[Legendre::MaxDegree + 1], pv[Legendre::MaxDegree + 1];
+			Legendre::values(degree, u, pu);
+			Legendre::values(degree, w, pv);
+
+			int terms = Legendre::terms_number(degree);
+			Real sum = Real(0.0);
+			for (int k = 0; k < terms; ++k)
+				sum += a[k] * pu[ex[k]] * pv[ey[k]];
+
+			return sum;
+		}
+
+		// the trailing terms(v) rows, the basis of degree(v)
+		void cell_coefficients(int v, int c, Real *a) const
+		{
+			assert(_terms <= Legendre::MaxTerms);
+
+			int terms = this->terms(v);
+			const Real *p = &_coeff[(c * _terms + _terms - terms) * _capacity + v];
+			for (int k = 0; k < terms; ++k)
+				a[k] = p[k * _capacity];
+		}
+
+		void reserve(int capacity)
+		{
+			std::vector<Real> coeff(_channel * _terms * capacity, Real(0.0));
+			for (int r = 0; r < _channel * _terms; ++r)
+			{
+				std::copy(
+					_coeff.begin() + r * _capacity,
+					_coeff.begin() + r * _capacity + _cells,
+					coeff.begin() + r * capacity);
+			}
+
+			_coeff.swap(coeff);
+			_capacity = capacity;
+		}
+	};
+}
+
+#endif
@@ -1,4 +1,5 @@
 
+#include <math.h>
 #include <algorithm>
 #include "rasterizer.h"
 
@@ -23,114 +24,183 @@ namespace xyy
 		if (j == height) --j;
 	}
 
-	void Rasterizer::rasterize(const double *polygon, int vnb, int width, int height, PixelSet &pixels)
+	void Rasterizer::row_range(const double *polygon, int vnb, int width, int height, int &ymin, int &ymax)
 	{
-		pixels.clear();
+		ymin = 0;
+		ymax = -1;
 
 		if (vnb < 3)
 			return;
 
-		double signed_area = (polygon[2] - polygon[0]) * (polygon[5] - polygon[1]) - (polygon[4] - polygon[0]) * (polygon[3] - polygon[1]);
-		bool ccw = (signed_area < 0.0);
+		double scale = 0.5 * width;
+		double ylo = polygon[1], yhi = polygon[1];
+		for (int v = 1; v < vnb; ++v)
+		{
+			ylo = std::min(ylo, polygon[2 * v + 1]);
+			yhi = std::max(yhi, polygon[2 * v + 1]);
+		}
 
-		std::vector<int> x_;
-		std::vector<int> y_;
-		pixels.ymin = height;
-		pixels.ymax = -1;
-		for (int v = 0; v < vnb; ++v)
+		// rows whose pixel centers lie in [ylo, yhi)
+		ymin = std::max(0, (int)ceil(ylo * scale + 0.5 * height - 0.5));
+		ymax = std::min(height - 1, (int)ceil(yhi * scale + 0.5 * height - 0.5) - 1);
+	}
+
+	void Rasterizer::rasterize(const double *polygon, int vnb, int width, int height, PixelSets &pixels, int v)
+	{
+		int ymin = 0, ymax = -1;
+		row_range(polygon, vnb, width, height, ymin, ymax);
+
+		pixels.set_rows(v, ymin, ymax);
+		if (ymax >= ymin)
+			rasterize(polygon, vnb, width, height, ymin, ymax, pixels.left(v), pixels.right(v));
+	}
+
+	void Rasterizer::rasterize_rows(const double *polygon, int vnb, int width, int height, int y0, int y1, PixelSets &pixels, int v)
+	{
+		int ymin = 0, ymax = -1;
+		row_range(polygon, vnb, width, height, ymin, ymax);
+
+		ymin = std::max(ymin, y0);
+		ymax = std::min(ymax, y1);
+		if (ymax < ymin)
 		{
-			int i = -1, j = -1;
-			locate_point(width, height, &polygon[2 * v], i, j);
+			ymin = 0;
+			ymax = -1;
+		}
 
-			x_.push_back(i);
-			y_.push_back(j);
+		pixels.set_rows(v, ymin, ymax);
+		if (ymax >= ymin)
+			rasterize(polygon, vnb, width, height, ymin, ymax, pixels.left(v), pixels.right(v));
+	}
 
-			pixels.ymin = std::min(pixels.ymin, j);
-			pixels.ymax = std::max(pixels.ymax, j);
+	void Rasterizer::rasterize(
+		const double *points,
+		const int *offsets,
+		int cnb,
+		int width,
+		int height,
+		int *labels,
+		PixelSets *pixels,
+		Workspace *workspace)
+	{
+		if (labels)
+		{
+			std::fill(labels, labels + width * height, -1);
 		}
 
-		int* x_left = new int[height];
-		int* x_right = new int[height];
-		for (int j = pixels.ymin; j <= pixels.ymax; ++j)
+		Workspace local;
+		Workspace &ws = workspace ? *workspace : local;
+
+		// spans of all cells are packed in one buffer, laid out in cell order
+		PixelSets &spans = pixels ? *pixels : ws.spans;
+		spans.clear();
+		spans.resize(cnb);
+
+		for (int v = 0; v < cnb; ++v)
 		{
-			x_left[j] = width - 1;
-			x_right[j] = 0;
+			int start = offsets[v];
+			rasterize(&points[2 * start], offsets[v + 1] - start, width, height, spans, v);
 		}
-		
-		rasterize(ccw, x_, y_, x_left, x_right);
-		
-		for (int j = pixels.ymin; j <= pixels.ymax; ++j)
+
+		if (!labels)
+			return;
+
+		// bucket cells by their first row
+		std::vector<int> &rowStart = ws.rowStart;
+		std::vector<int> &rowCells = ws.rowCells;
+		rowStart.assign(height + 1, 0);
+		rowCells.resize(cnb);
+		for (int v = 0; v < cnb; ++v)
 		{
-			pixels.left.push_back(x_left[j]);
-			pixels.right.push_back(x_right[j]);
+			if (spans.ymax(v) >= spans.ymin(v))
+				++rowStart[spans.ymin(v) + 1];
 		}
 
-		delete[] x_left;
-		x_left = NULL;
-		delete[] x_right;
-		x_right = NULL;
-	}
+		for (int j = 0; j < height; ++j)
+			rowStart[j + 1] += rowStart[j];
 
-	void Rasterizer::rasterize(bool ccw, const std::vector<int> &x_, const std::vector<int> &y_, int *x_left, int *x_right)
-	{
-		int N = (int)x_.size();
+		std::vector<int> &rowFill = ws.rowFill;
+		rowFill.assign(rowStart.begin(), rowStart.end() - 1);
+		for (int v = 0; v < cnb; ++v)
+		{
+			if (spans.ymax(v) >= spans.ymin(v))
+				rowCells[rowFill[spans.ymin(v)]++] = v;
+		}
 
-		for (int i = 0; i < N; ++i)
+		// sweep rows top to bottom, keeping the cells that cross the current row
+		std::vector<int> &active = ws.active;
+		active.clear();
+		for (int j = 0; j < height; ++j)
 		{
-			int j = (i + 1) % N;
-			int x1 = x_[i];
-			int y1 = y_[i];
-			int x2 = x_[j];
-			int y2 = y_[j];
-			if (y1 == y2)
+			active.insert(active.end(), rowCells.begin() + rowStart[j], rowCells.begin() + rowStart[j + 1]);
+
+			int lineStart = j * width;
+			for (size_t k = 0; k < active.size();)
 			{
-				if (x2 > x1)
+				int v = active[k];
+				PixelSet ps = spans[v];
+				int loc = j - ps.ymin;
+
+				if (ps.left[loc] <= ps.right[loc])
 				{
-					x_left[y1] = std::min(x_left[y1], x1);
-					x_right[y1] = std::max(x_right[y1], x2);
+					std::fill(labels + lineStart + ps.left[loc], labels + lineStart + ps.right[loc] + 1, v);
 				}
-				else
+
+				if (ps.ymax == j)
 				{
-					x_left[y1] = std::min(x_left[y1], x2);
-					x_right[y1] = std::max(x_right[y1], x1);
+					active[k] = active.back();
+					active.pop_back();
 				}
-				continue;
+				else
+					++k;
 			}
+		}
+	}
+
+	void Rasterizer::rasterize(const double *polygon, int vnb, int width, int height, int ymin, int ymax, int *x_left, int *x_right)
+	{
+		for (int j = ymin; j <= ymax; ++j)
+		{
+			x_left[j - ymin] = width;
+			x_right[j - ymin] = -1;
+		}
+
+		double scale = 0.5 * width;
+		double yoffset = 0.5 * height;
 
-			bool is_left = (y2 < y1) ^ ccw;
+		for (int v = 0; v < vnb; ++v)
+		{
+			const double *p = &polygon[2 * v];
+			const double *q = &polygon[2 * ((v + 1) % vnb)];
+			if (p[1] == q[1])
+				continue;
 
-			// Bresenham algo.
-			int dx = x2 - x1;
-			int dy = y2 - y1;
-			int sx = dx > 0 ? 1 : -1;
-			int sy = dy > 0 ? 1 : -1;
-			dx *= sx;
-			dy *= sy;
-			int x = x1;
-			int y = y1;
+			// orient the edge bottom-up, so both cells sharing it compute the same crossings
+			if (p[1] > q[1])
+				std::swap(p, q);
 
-			int* line_x = is_left ? x_left : x_right;
-			if ((is_left && sx > 0) || (!is_left && sx < 0))
-				line_x[y] = x;
+			double px = (p[0] + 1.0) * scale, py = p[1] * scale + yoffset;
+			double qx = (q[0] + 1.0) * scale, qy = q[1] * scale + yoffset;
+			double dxdy = (qx - px) / (qy - py);
 
-			int e = dy - dx;
-			while ((sy > 0 && y < y2) || (sy < 0 && y > y2))
+			// half-open in y: the edge covers the row centers in [py, qy)
+			int j0 = std::max(ymin, (int)ceil(py - 0.5));
+			int j1 = std::min(ymax, (int)ceil(qy - 0.5) - 1);
+			for (int j = j0; j <= j1; ++j)
 			{
-				while (e < 0 || (e == 0 && ((is_left && sx > 0) || (!is_left && sx < 0))))
-				{
-					x += sx;
-					e += 2 * dy;
-				}
-				if ((!is_left && sx > 0) || (is_left && sx < 0))
-					line_x[y] = x;
-				y += sy;
-				e -= 2 * dx;
-				if ((is_left && sx > 0) || (!is_left && sx < 0))
-					line_x[y] = x;
+				double x = px + (j + 0.5 - py) * dxdy;
+
+				// half-open in x: pixel centers in [xl, xr)
+				int i = (int)ceil(x - 0.5);
+				x_left[j - ymin] = std::min(x_left[j - ymin], i);
+				x_right[j - ymin] = std::max(x_right[j - ymin], i - 1);
 			}
-			if ((!is_left && sx > 0) || (is_left && sx < 0))
-				line_x[y2] = x2;
+		}
+
+		for (int j = ymin; j <= ymax; ++j)
+		{
+			x_left[j - ymin] = std::max(x_left[j - ymin], 0);
+			x_right[j - ymin] = std::min(x_right[j - ymin], width - 1);
 		}
 	}
 }
-
@@ -7,18 +7,58 @@
 #ifndef RASTERIZER_H
 #define RASTERIZER_H
 
+#include <cstddef>
+#include <vector>
 #include "pixelset.h"
 
 namespace xyy
 {
+	/**
+	* scan conversion of convex polygons given in [-1, 1] x [-h/w, h/w]
+	* a pixel belongs to a polygon iff its center does, with half-open
+	* (top-left) rule on edges, so cells sharing edges never share pixels
+	*/
 	class Rasterizer
 	{
 	public:
+		// scratch buffers of the diagram pass, keep one alive to avoid reallocating per call
+		struct Workspace
+		{
+			PixelSets        spans;
+			std::vector<int> rowStart;
+			std::vector<int> rowCells;
+			std::vector<int> rowFill;
+			std::vector<int> active;
+		};
+
+
 		static void locate_point(int w, int h, const double *p, int &i, int &j);
-		static void rasterize(const double *polygon, int vnb, int width, int height, PixelSet &pixels);
+		// (re)builds set v of pixels
+		static void rasterize(const double *polygon, int vnb, int width, int height, PixelSets &pixels, int v);
+
+		// (re)builds set v of the pixels in rows [y0, y1], the same spans as the full set there
+		static void rasterize_rows(const double *polygon, int vnb, int width, int height, int y0, int y1, PixelSets &pixels, int v);
+
+		/**
+		* rasterize all cells of a diagram in one scanline pass
+		* polygon v is points[2 * offsets[v]] ... points[2 * offsets[v + 1]]
+		* labels (width * height, may be NULL) gets the cell ID of each pixel, -1 if uncovered
+		* pixels (may be NULL) gets the per-cell spans
+		* workspace (may be NULL) holds the scratch buffers
+		*/
+		static void rasterize(
+			const double *points,
+			const int *offsets,
+			int cnb,
+			int width,
+			int height,
+			int *labels,
+			PixelSets *pixels = NULL,
+			Workspace *workspace = NULL);
 
 	protected:
-		static void rasterize(bool ccw, const std::vector<int> &x_, const std::vector<int> &y_, int *x_left, int *x_right);
+		static void row_range(const double *polygon, int vnb, int width, int height, int &ymin, int &ymax);
+		static void rasterize(const double *polygon, int vnb, int width, int height, int ymin, int ymax, int *x_left, int *x_right);
 	};
 }
 
@@ -0,0 +1,196 @@
+#include "span_kernels.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace xyy
+{
+	static void powers_scalar(int n, double x0, double dx, double *s, int maxp)
+	{
+		double sum[9] = { 0.0 };
+		for (int i = 0; i < n; ++i)
+		{
+			double x = x0 + i * dx;
+			double xp = 1.0;
+			for (int p = 0; p <= maxp; ++p)
+			{
+				sum[p] += xp;
+				xp *= x;
+			}
+		}
+
+		for (int p = 0; p <= maxp; ++p)
+			s[p] += sum[p];
+	}
+
+	static void moments_scalar(const float *f, int n, double x0, double dx, double *s, int maxp)
+	{
+		double sum[5] = { 0.0 };
+		for (int i = 0; i < n; ++i)
+		{
+			double x = x0 + i * dx;
+			double v = f[i];
+			for (int p = 0; p <= maxp; ++p)
+			{
+				sum[p] += v;
+				v *= x;
+			}
+		}
+
+		for (int p = 0; p <= maxp; ++p)
+			s[p] += sum[p];
+	}
+
+	static inline double horner(const double *b, int degree, double x)
+	{
+		double result = b[degree];
+		for (int p = degree - 1; p >= 0; --p)
+			result = result * x + b[p];
+
+		return result;
+	}
+
+	static double energy_scalar(const float *f, int n, double x0, double dx, const double *b, int degree)
+	{
+		double sum = 0.0;
+		for (int i = 0; i < n; ++i)
+		{
+			double diff = f[i] - horner(b, degree, x0 + i * dx);
+			sum += diff * diff;
+		}
+
+		return sum;
+	}
+
+	static void evaluate_scalar(float *out, int n, double x0, double dx, const double *b, int degree)
+	{
+		for (int i = 0; i < n; ++i)
+			out[i] = float(horner(b, degree, x0 + i * dx));
+	}
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	// NEON is part of the aarch64 baseline, no runtime check needed
+	static inline float64x2_t lane_x(int i, double x0, double dx)
+	{
+		const double offsets[2] = { 0.0, 1.0 };
+		float64x2_t index = vaddq_f64(vdupq_n_f64(double(i)), vld1q_f64(offsets));
+		return vfmaq_f64(vdupq_n_f64(x0), index, vdupq_n_f64(dx));
+	}
+
+	static inline float64x2_t lane_horner(const double *b, int degree, float64x2_t x)
+	{
+		float64x2_t result = vdupq_n_f64(b[degree]);
+		for (int p = degree - 1; p >= 0; --p)
+			result = vfmaq_f64(vdupq_n_f64(b[p]), result, x);
+
+		return result;
+	}
+
+	static void moments_neon(const float *f, int n, double x0, double dx, double *s, int maxp)
+	{
+		float64x2_t sum[5];
+		for (int p = 0; p <= maxp; ++p)
+			sum[p] = vdupq_n_f64(0.0);
+
+		int i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			float64x2_t x = lane_x(i, x0, dx);
+			float64x2_t v = vcvt_f64_f32(vld1_f32(f + i));
+			for (int p = 0; p <= maxp; ++p)
+			{
+				sum[p] = vaddq_f64(sum[p], v);
+				v = vmulq_f64(v, x);
+			}
+		}
+
+		for (int p = 0; p <= maxp; ++p)
+			s[p] += vaddvq_f64(sum[p]);
+
+		moments_scalar(f + i, n - i, x0 + i * dx, dx, s, maxp);
+	}
+
+	static double energy_neon(const float *f, int n, double x0, double dx, const double *b, int degree)
+	{
+		float64x2_t sum = vdupq_n_f64(0.0);
+
+		int i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			float64x2_t p = lane_horner(b, degree, lane_x(i, x0, dx));
+			float64x2_t diff = vsubq_f64(vcvt_f64_f32(vld1_f32(f + i)), p);
+			sum = vfmaq_f64(sum, diff, diff);
+		}
+
+		return vaddvq_f64(sum) + energy_scalar(f + i, n - i, x0 + i * dx, dx, b, degree);
+	}
+
+	static void evaluate_neon(float *out, int n, double x0, double dx, const double *b, int degree)
+	{
+		int i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			float64x2_t p = lane_horner(b, degree, lane_x(i, x0, dx));
+			vst1_f32(out + i, vcvt_f32_f64(p));
+		}
+
+		evaluate_scalar(out + i, n - i, x0 + i * dx, dx, b, degree);
+	}
+#endif
+
+	static bool cpu_has_avx2()
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+
+		// the os has to save the ymm registers
+		return fma && avx2 && osxsave && (_xgetbv(0) & 6) == 6;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		return false;
+#endif
+	}
+
+	static SpanKernels select_span_kernels()
+	{
+		SpanKernels kernels;
+		kernels.powers = powers_scalar;
+		kernels.moments = moments_scalar;
+		kernels.energy = energy_scalar;
+		kernels.evaluate = evaluate_scalar;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+		kernels.moments = moments_neon;
+		kernels.energy = energy_neon;
+		kernels.evaluate = evaluate_neon;
+#endif
+
+		if (cpu_has_avx2())
+			span_kernels_avx2(kernels);
+
+		return kernels;
+	}
+
+	const SpanKernels& span_kernels()
+	{
+		static const SpanKernels kernels = select_span_kernels();
+		return kernels;
+	}
+}
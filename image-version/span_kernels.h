@@ -0,0 +1,39 @@
+
+/**
+* author: Yanyang Xiao
+* email : yanyangxiaoxyy@gmail.com
+*/
+
+#ifndef SPAN_KERNELS_H
+#define SPAN_KERNELS_H
+
+namespace xyy
+{
+	/**
+	* loops over one span of a row, pixel i sits at x = x0 + i * dx
+	* sums are accumulated in double, results are added to the output
+	* the row polynomial is sum_p b[p] * x^p, p <= degree
+	*/
+	struct SpanKernels
+	{
+		// s[p] += sum x^p, p <= maxp <= 8
+		void (*powers)(int n, double x0, double dx, double *s, int maxp);
+
+		// s[p] += sum f * x^p, p <= maxp <= 4
+		void (*moments)(const float *f, int n, double x0, double dx, double *s, int maxp);
+
+		// sum (f - poly)^2
+		double (*energy)(const float *f, int n, double x0, double dx, const double *b, int degree);
+
+		// out[i] = poly
+		void (*evaluate)(float *out, int n, double x0, double dx, const double *b, int degree);
+	};
+
+	// the widest set the cpu supports, picked on first use
+	const SpanKernels& span_kernels();
+
+	// fills in the AVX2 kernels, false if they were not compiled in
+	bool span_kernels_avx2(SpanKernels &kernels);
+}
+
+#endif
@@ -0,0 +1,171 @@
+// built with AVX2 / FMA enabled, only reached after the runtime check in span_kernels()
+#include "span_kernels.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+
+namespace xyy
+{
+	static inline double hsum(__m256d v)
+	{
+		__m128d lo = _mm256_castpd256_pd128(v);
+		__m128d hi = _mm256_extractf128_pd(v, 1);
+		lo = _mm_add_pd(lo, hi);
+		return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+	}
+
+	// x of pixels i ... i + 3
+	static inline __m256d lane_x(int i, __m256d x0, __m256d dx)
+	{
+		__m256d index = _mm256_add_pd(_mm256_set1_pd(double(i)), _mm256_set_pd(3.0, 2.0, 1.0, 0.0));
+		return _mm256_fmadd_pd(index, dx, x0);
+	}
+
+	static inline __m256d lane_horner(const double *b, int degree, __m256d x)
+	{
+		__m256d result = _mm256_set1_pd(b[degree]);
+		for (int p = degree - 1; p >= 0; --p)
+			result = _mm256_fmadd_pd(result, x, _mm256_set1_pd(b[p]));
+
+		return result;
+	}
+
+	static inline double horner(const double *b, int degree, double x)
+	{
+		double result = b[degree];
+		for (int p = degree - 1; p >= 0; --p)
+			result = result * x + b[p];
+
+		return result;
+	}
+
+	static void powers_avx2(int n, double x0, double dx, double *s, int maxp)
+	{
+		__m256d vx0 = _mm256_set1_pd(x0), vdx = _mm256_set1_pd(dx);
+
+		__m256d sum[9];
+		for (int p = 1; p <= maxp; ++p)
+			sum[p] = _mm256_setzero_pd();
+
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d x = lane_x(i, vx0, vdx);
+			__m256d xp = x;
+			for (int p = 1; p <= maxp; ++p)
+			{
+				sum[p] = _mm256_add_pd(sum[p], xp);
+				xp = _mm256_mul_pd(xp, x);
+			}
+		}
+
+		s[0] += i;
+		for (int p = 1; p <= maxp; ++p)
+			s[p] += hsum(sum[p]);
+
+		for (; i < n; ++i)
+		{
+			double x = x0 + i * dx;
+			double xp = 1.0;
+			for (int p = 0; p <= maxp; ++p)
+			{
+				s[p] += xp;
+				xp *= x;
+			}
+		}
+	}
+
+	static void moments_avx2(const float *f, int n, double x0, double dx, double *s, int maxp)
+	{
+		__m256d vx0 = _mm256_set1_pd(x0), vdx = _mm256_set1_pd(dx);
+
+		__m256d sum[5];
+		for (int p = 0; p <= maxp; ++p)
+			sum[p] = _mm256_setzero_pd();
+
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d x = lane_x(i, vx0, vdx);
+			__m256d v = _mm256_cvtps_pd(_mm_loadu_ps(f + i));
+			for (int p = 0; p <= maxp; ++p)
+			{
+				sum[p] = _mm256_add_pd(sum[p], v);
+				v = _mm256_mul_pd(v, x);
+			}
+		}
+
+		for (int p = 0; p <= maxp; ++p)
+			s[p] += hsum(sum[p]);
+
+		for (; i < n; ++i)
+		{
+			double x = x0 + i * dx;
+			double v = f[i];
+			for (int p = 0; p <= maxp; ++p)
+			{
+				s[p] += v;
+				v *= x;
+			}
+		}
+	}
+
+	static double energy_avx2(const float *f, int n, double x0, double dx, const double *b, int degree)
+	{
+		__m256d vx0 = _mm256_set1_pd(x0), vdx = _mm256_set1_pd(dx);
+		__m256d sum = _mm256_setzero_pd();
+
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d p = lane_horner(b, degree, lane_x(i, vx0, vdx));
+			__m256d diff = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(f + i)), p);
+			sum = _mm256_fmadd_pd(diff, diff, sum);
+		}
+
+		double result = hsum(sum);
+		for (; i < n; ++i)
+		{
+			double diff = f[i] - horner(b, degree, x0 + i * dx);
+			result += diff * diff;
+		}
+
+		return result;
+	}
+
+	static void evaluate_avx2(float *out, int n, double x0, double dx, const double *b, int degree)
+	{
+		__m256d vx0 = _mm256_set1_pd(x0), vdx = _mm256_set1_pd(dx);
+
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d p = lane_horner(b, degree, lane_x(i, vx0, vdx));
+			_mm_storeu_ps(out + i, _mm256_cvtpd_ps(p));
+		}
+
+		for (; i < n; ++i)
+			out[i] = float(horner(b, degree, x0 + i * dx));
+	}
+
+	bool span_kernels_avx2(SpanKernels &kernels)
+	{
+		kernels.powers = powers_avx2;
+		kernels.moments = moments_avx2;
+		kernels.energy = energy_avx2;
+		kernels.evaluate = evaluate_avx2;
+		return true;
+	}
+}
+
+#else
+
+namespace xyy
+{
+	bool span_kernels_avx2(SpanKernels &)
+	{
+		return false;
+	}
+}
+
+#endif
@@ -1,10 +1,19 @@
 
 #include <map>
+#include <algorithm>
+#include <numeric>
+#include <float.h>
+#include <random>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "voroapprox.h"
-#include "rasterizer.h"
+#include "alias_table.h"
 #include "../xlog.h"
+#include "../alloc_counter.h"
 
-VoroApprox::VoroApprox() : _dt(NULL), _voro(NULL)
+VoroApprox::VoroApprox() : _dt(NULL), _voro(NULL), _rt(NULL), _power(NULL), _sampleStep(1), _fitStep(1), _sampleRound(0),
+	_diagramVersion(0), _pixelsVersion(-1), _fitVersion(-1)
 { }
 
 VoroApprox::~VoroApprox()
@@ -20,6 +29,27 @@ VoroApprox::~VoroApprox()
 		delete _voro;
 		_voro = NULL;
 	}
+
+	if (_rt)
+	{
+		delete _rt;
+		_rt = NULL;
+	}
+
+	if (_power)
+	{
+		delete _power;
+		_power = NULL;
+	}
+}
+
+void VoroApprox::set_power_diagram(bool on)
+{
+	_params.powerDiagram = on;
+	_weights.resize(sites_number(), 0.0);
+
+	// the cells of the other mode are stale
+	compute_voronoi();
 }
 
 void VoroApprox::set_image(const unsigned char *image, int width, int height, int channel)
@@ -30,6 +60,14 @@ void VoroApprox::set_image(const unsigned char *image, int width, int height, in
 		_voro = NULL;
 	}
 
+	if (_power)
+	{
+		delete _power;
+		_power = NULL;
+	}
+
+	++_diagramVersion;
+
 	_params.image = image;
 	_params.width = width;
 	_params.height = height;
@@ -38,6 +76,12 @@ void VoroApprox::set_image(const unsigned char *image, int width, int height, in
 	_params.ratio = double(height) / width;
 	_params.pixWidth = 2.0 / width;
 	_params.pixArea = _params.pixWidth * _params.pixWidth;
+
+	// converted once, the span kernels read floats
+	if (image)
+		_planar.set(image, width, height, channel);
+	else
+		_planar.clear();
 }
 
 void VoroApprox::random_init(int vnb)
@@ -56,11 +100,18 @@ void VoroApprox::random_init(int vnb)
 		_sites[2 * i + 1] = (double(rand()) / RAND_MAX * 2.0 - 1.0) * _params.ratio;
 	}
 
+	_weights.assign(vnb, 0.0);
+
 	compute_voronoi();
 }
 
 void VoroApprox::greedy_init(int vnb)
 {
+	// the weights start at zero, where both diagrams agree, and
+	// the incremental updates below need the Delaunay triangulation
+	bool power = _params.powerDiagram;
+	_params.powerDiagram = false;
+
 	int initN = 3;
 	random_init(initN);
 
@@ -80,25 +131,9 @@ void VoroApprox::greedy_init(int vnb)
 		int v = top->second;
 		mMap.erase(top);
 
-		const MyPolygonCell *cell = _voro->cell(v);
-		assert(cell);
-
-		const double *maxP = NULL;
-		double maxDist = 0;
-
-		for (int i = cell->face_begin(0); i < cell->face_end(0); ++i)
-		{
-			const double *p = cell->point(i);
-			double dx = p[0] - _sites[2 * v];
-			double dy = p[1] - _sites[2 * v + 1];
-			double dist = dx * dx + dy * dy;
-
-			if (dist > maxDist)
-			{
-				maxDist = dist;
-				maxP = p;
-			}
-		}
+		double maxP[2];
+		if (!farthest_corner(v, maxP))
+			continue;
 
 		_sites.push_back(maxP[0]);
 		_sites.push_back(maxP[1]);
@@ -106,6 +141,7 @@ void VoroApprox::greedy_init(int vnb)
 		DelaunayTriangulation2D::Vertex_handle newVH = _dt->add_vertex(maxP);
 		int newVID = newVH->index();
 
+		MyPolygonCell cell = _voro->cell(v);
 		std::vector<int> updateList;
 		DelaunayTriangulation2D::Vertex_circulator vvit = _dt->incident_vertices(newVH);
 		DelaunayTriangulation2D::Vertex_circulator vvend = vvit;
@@ -132,11 +168,12 @@ void VoroApprox::greedy_init(int vnb)
 
 		updateList.push_back(newVID);
 
-		_voro->cells().push_back(MyPolygonCell());
+		_voro->cells().add_cell();
 		_voro->compute(_dt, newVID);
+		++_diagramVersion;
 
-		_pixels.push_back(PixelSet());
-		_polynomials.push_back(MyPolynomial());
+		_pixels.add_set();
+		_coefficients.add_cell();
 		_energies.push_back(0);
 
 		for (auto it = updateList.begin(); it != updateList.end(); ++it)
@@ -144,27 +181,45 @@ void VoroApprox::greedy_init(int vnb)
 			cell = _voro->cell(*it);
 
 			std::vector<double> polygon;
-			cell->face_polygon(0, polygon);
-			Rasterizer::rasterize(&polygon[0], (int)polygon.size() / 2, _params.width, _params.height, _pixels[*it]);
+			cell.face_polygon(0, polygon);
+			Rasterizer::rasterize(&polygon[0], (int)polygon.size() / 2, _params.width, _params.height, _pixels, *it);
 
-			_polynomials[*it].compute_factors(
+			PixelSet pixels = _pixels[*it];
+
+			MyPolynomial polynomial(_params.degree);
+			polynomial.compute_factors(
 				_params.image,
 				_params.width,
 				_params.height,
 				_params.channel,
-				&_pixels[*it]);
+				&pixels);
+			_coefficients.set(*it, polynomial.coefficients(), polynomial.transform());
 
-			_energies[*it] = _polynomials[*it].compute_energy(
+			_energies[*it] = _coefficients.compute_energy(
+				*it,
 				_params.image,
 				_params.width,
 				_params.height,
 				_params.channel,
-				&_pixels[*it],
+				&pixels,
 				_params.Lp);
 
 			mMap.insert(std::make_pair(_energies[*it], *it));
 		}
+
+		// rebuilt sets leave stale rows behind
+		if (_pixels.garbage() > _pixels.rows_number() / 2)
+			_pixels.compact();
 	}
+
+	// the cells were rasterized one by one, the pixels are not labeled
+	_labels.clear();
+
+	_weights.assign(sites_number(), 0.0);
+
+	_params.powerDiagram = power;
+	if (power)
+		compute_voronoi();
 }
 
 void VoroApprox::set_sites(const double *sites, int n)
@@ -173,394 +228,2223 @@ void VoroApprox::set_sites(const double *sites, int n)
 	_sites.resize(n * 2);
 
 	memcpy(&_sites[0], sites, sizeof(double) * n * 2);
+	_weights.assign(n, 0.0);
 
 	compute_voronoi();
 }
 
-void VoroApprox::compute_voronoi()
+/**
+* Lloyd relaxation from a jittered grid, each round moves every site to the centroid of its cell
+* the centroids are independent, a round is one diagram plus a parallel loop
+*/
+void VoroApprox::cvt_init(int vnb, int iteration /* = 10*/)
 {
-	if (_sites.empty() || !_params.image)
+	if (!_params.image || vnb < 1)
 		return;
 
-	if (!_dt)
-		_dt = new DelaunayTriangulation2D;
-
-	_dt->set_vertices(&_sites[0], (int)_sites.size() / 2);
-
-	if (!_voro)
-	{
-		_voro = new MyVoronoi;
-
-		double rect[8] = { -1, -_params.ratio, 1, -_params.ratio, 1, _params.ratio, -1, _params.ratio };
-		_voro->add_domain(rect, 4);
-	}
-
-	_voro->compute(_dt);
-}
-
-void VoroApprox::assign_pixels()
-{
-	if (!_voro)
-		return;
+	srand((unsigned int)time(NULL));
 
-	int vnb = _voro->cells_number();
+	// about square strata, the last row may be partially filled
+	int cols = (std::max)(1, (int)std::ceil(std::sqrt(vnb / _params.ratio)));
+	int rows = (vnb + cols - 1) / cols;
+	double dx = 2.0 / cols;
+	double dy = 2.0 * _params.ratio / rows;
 
-	_pixels.clear();
-	_pixels.resize(vnb);
+	_sites.clear();
+	_sites.resize(2 * vnb);
 
 	for (int i = 0; i < vnb; ++i)
 	{
-		const MyPolygonCell *cell = _voro->cell(i);
-		if (!cell)
-			continue;
-
-		std::vector<double> polygon;
-		cell->face_polygon(0, polygon);
-		Rasterizer::rasterize(&polygon[0], (int)polygon.size() / 2, _params.width, _params.height, _pixels[i]);
+		_sites[2 * i] = -1.0 + (i % cols + double(rand()) / RAND_MAX) * dx;
+		_sites[2 * i + 1] = -_params.ratio + (i / cols + double(rand()) / RAND_MAX) * dy;
 	}
-}
 
-void VoroApprox::compute_polynomials()
-{
-	if (!_voro || !_params.image || _pixels.empty())
-		return;
+	_weights.assign(vnb, 0.0);
 
-	_polynomials.clear();
-	_polynomials.resize(_pixels.size(), MyPolynomial(_params.degree));
+	compute_voronoi();
 
-	int vnb = _voro->cells_number();
-	for (int i = 0; i < vnb; ++i)
+	for (int it = 0; it < iteration && has_diagram(); ++it)
 	{
-		_polynomials[i].compute_factors(
-			_params.image,
-			_params.width,
-			_params.height,
-			_params.channel,
-			&_pixels[i]);
-	}
-}
+		double moved = 0.0;
 
-double VoroApprox::compute_energies()
-{
-	if (!_voro || !_params.image || _pixels.empty() || _polynomials.empty())
-		return 1e10;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:moved)
+		for (int v = 0; v < vnb; ++v)
+		{
+			MyPolygonCell cell = this->cell(v);
+			if (cell.faces_number() < 1)
+				continue;
 
-	double sum = 0.0;
+			double cent[2];
+			if (cell.face_centroid(0, cent) <= 0.0)
+				continue;
 
-	int vnb = _voro->cells_number();
-	_energies.clear();
-	_energies.resize(vnb, 0.0);
-	for (int i = 0; i < vnb; ++i)
-	{
-		_energies[i] = _polynomials[i].compute_energy(
-			_params.image,
-			_params.width,
-			_params.height,
-			_params.channel,
-			&_pixels[i],
-			_params.Lp);
+			double ddx = cent[0] - _sites[2 * v];
+			double ddy = cent[1] - _sites[2 * v + 1];
+			moved += ddx * ddx + ddy * ddy;
 
-		sum += _energies[i];
-	}
+			_sites[2 * v] = cent[0];
+			_sites[2 * v + 1] = cent[1];
+		}
 
-	return sum;
+		compute_voronoi();
+
+		// converged once the sites move less than a tenth of a pixel
+		double rms = std::sqrt(moved / vnb) / _params.pixWidth;
+		xlog("it = %d, rms move = %f pixels", it + 1, rms);
+		if (rms < 0.1)
+			break;
+	}
 }
 
-void VoroApprox::compute_gradients(double *g, int n)
+/**
+* sites drawn from a density that follows the image gradient, an alias table sample per site
+* with blueNoise a pool of candidates is thinned by dart throwing: a candidate closer than
+* half the local spacing to an accepted site is rejected, the pool tops up the remainder
+*/
+void VoroApprox::importance_init(int vnb, bool blueNoise /* = true*/)
 {
-	if (!_params.image || !_voro)
+	if (!_params.image || vnb < 1)
 		return;
 
-	assert(n == _voro->cells_number());
+	int width = _params.width;
+	int height = _params.height;
+	int channel = _params.channel;
 
-	for (int v = 0; v < n; ++v)
-	{
-		g[2 * v] = 0.0;
-		g[2 * v + 1] = 0.0;
+	// gradient magnitude by central differences
+	std::vector<double> density(size_t(width) * height);
 
-		const MyPolygonCell *cell = _voro->cell(v);
-		if (!cell)
-			continue;
+#pragma omp parallel for
+	for (int j = 0; j < height; ++j)
+	{
+		int j0 = (std::max)(j - 1, 0);
+		int j1 = (std::min)(j + 1, height - 1);
 
-		for (int i = cell->face_begin(0); i < cell->face_end(0); ++i)
+		for (int i = 0; i < width; ++i)
 		{
-			int nv = cell->point_flag(i);
-			if (nv < 0)
-				continue;
+			int i0 = (std::max)(i - 1, 0);
+			int i1 = (std::min)(i + 1, width - 1);
 
-			int next = cell->next_around_face(0, i);
-			const double *source = cell->point(i);
-			const double *target = cell->point(next);
-
-			double result[2] = { 0.0, 0.0 };
-			compute_gradient(
-				&_sites[2 * v],
-				&_polynomials[v],
-				&_sites[2 * nv],
-				&_polynomials[nv],
-				source,
-				target,
-				result);
+			double g = 0.0;
+			for (int c = 0; c < channel; ++c)
+			{
+				double gx = i1 > i0 ? (_planar.row(c, j)[i1] - _planar.row(c, j)[i0]) / (i1 - i0) : 0.0;
+				double gy = j1 > j0 ? (_planar.row(c, j1)[i] - _planar.row(c, j0)[i]) / (j1 - j0) : 0.0;
+				g += gx * gx + gy * gy;
+			}
 
-			g[2 * v] += result[0];
-			g[2 * v + 1] += result[1];
+			density[size_t(j) * width + i] = std::sqrt(g);
 		}
 	}
-}
 
-void VoroApprox::compute_gradient(
-	const double *A,
-	const MyPolynomial *polynomialA,
-	const double *B,
-	const MyPolynomial *polynomialB,
-	const double *source,
-	const double *target,
-	double *result) const
-{
-	result[0] = 0.0;
-	result[1] = 0.0;
+	// flat regions still get sites
+	double sum = std::accumulate(density.begin(), density.end(), 0.0);
+	double minimum = 0.1 * sum / density.size() + 1e-6;
+	for (size_t k = 0; k < density.size(); ++k)
+		density[k] += minimum;
+	sum += minimum * density.size();
 
-	double dx = source[0] - target[0];
-	double dy = source[1] - target[1];
-	double length = std::sqrt(dx * dx + dy * dy);
-	int n = int(length / _params.pixWidth + 0.5);
-	//n *= 5;
+	AliasTable table;
+	table.build(&density[0], (int)density.size());
 
-	double ds = length / n;
-	int n2 = 2 * n;
-	for (int s = 1; s < n2; s += 2)
-	{
-		double lamda = double(s) / n2;
-		double p[2];
-		p[0] = source[0] * (1.0 - lamda) + target[0] * lamda;
-		p[1] = source[1] * (1.0 - lamda) + target[1] * lamda;
+	// candidates in pixel units, chunks have their own engines so the result
+	// does not depend on the number of threads
+	int cnb = blueNoise ? 4 * vnb : vnb;
+	std::vector<double> pool(2 * size_t(cnb));
+	std::vector<double> radius(cnb);
 
-		int i = -1, j = -1;
-		locate_point(p, i, j);
+	const int chunk = 4096;
+	int chunks = (cnb + chunk - 1) / chunk;
+	unsigned int seed = (unsigned int)time(NULL);
 
-		int pixID = j * _params.width + i;
-		const unsigned char* pixColor = &_params.image[_params.channel * pixID];
+#pragma omp parallel for
+	for (int k = 0; k < chunks; ++k)
+	{
+		std::mt19937 engine(seed + k);
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
 
-		double energyA = 0.0, energyB = 0.0;
-		for (int c = 0; c < _params.channel; ++c)
+		int end = (std::min)(cnb, (k + 1) * chunk);
+		for (int s = k * chunk; s < end; ++s)
 		{
-			double diff = double(pixColor[c]) - polynomialA->evaluate(c, p);
-			energyA += diff * diff;
-
-			diff = double(pixColor[c]) - polynomialB->evaluate(c, p);
-			energyB += diff * diff;
-		}
+			double u = uniform(engine);
+			int p = table.sample(u, uniform(engine));
 
-		double energyDiff = energyA - energyB;
-		double vec[2] = { p[0] - A[0], p[1] - A[1] };
+			pool[2 * s] = p % width + uniform(engine);
+			pool[2 * s + 1] = p / width + uniform(engine);
 
-		result[0] += energyDiff * vec[0] * ds;
-		result[1] += energyDiff * vec[1] * ds;
+			// half the spacing of vnb sites drawn with this density
+			radius[s] = 0.5 * std::sqrt(sum / (vnb * density[p]));
+		}
 	}
 
-	dx = B[0] - A[0];
-	dy = B[1] - A[1];
-	length = std::sqrt(dx * dx + dy * dy);
-	result[0] /= length;
-	result[1] /= length;
-}
-
-void VoroApprox::locate_point(const double *p, int &i, int &j) const
-{
-	double x = 0.5 * (p[0] + 1.0) / 1.0;
-	double y = 0.5 * (p[1] + _params.ratio) / _params.ratio;
+	std::vector<int> accepted;
+	if (blueNoise)
+	{
+		// buckets of the mean spacing, linked through next
+		double cellSize = (std::max)(1.0, std::sqrt(double(width) * height / vnb));
+		int gw = (int)std::ceil(width / cellSize);
+		int gh = (int)std::ceil(height / cellSize);
 
-	x = (std::max)(0.0, x);
-	x = (std::min)(1.0, x);
-	y = (std::max)(0.0, y);
-	y = (std::min)(1.0, y);
+		std::vector<int> head(size_t(gw) * gh, -1);
+		std::vector<int> next(cnb, -1);
+		std::vector<char> taken(cnb, 0);
 
-	i = (int)floor(x * double(_params.width));
-	j = (int)floor(y * double(_params.height));
+		accepted.reserve(vnb);
+		for (int s = 0; s < cnb && (int)accepted.size() < vnb; ++s)
+		{
+			const double *q = &pool[2 * s];
+			double r = (std::min)(radius[s], 4.0 * cellSize);
+			int range = (int)std::ceil(r / cellSize);
 
-	if (i == _params.width) --i;
-	if (j == _params.height) --j;
-}
+			int ci = (std::min)((int)(q[0] / cellSize), gw - 1);
+			int cj = (std::min)((int)(q[1] / cellSize), gh - 1);
 
-void VoroApprox::optimize(int degree, int iteration, double stepScale /* = 0.3*/)
-{
-	if (!_params.image || !_voro)
-		return;
+			bool rejected = false;
+			for (int bj = (std::max)(cj - range, 0); bj <= (std::min)(cj + range, gh - 1) && !rejected; ++bj)
+			{
+				for (int bi = (std::max)(ci - range, 0); bi <= (std::min)(ci + range, gw - 1) && !rejected; ++bi)
+				{
+					for (int t = head[bj * gw + bi]; t >= 0; t = next[t])
+					{
+						double dx = pool[2 * t] - q[0];
+						double dy = pool[2 * t + 1] - q[1];
+						if (dx * dx + dy * dy < r * r)
+						{
+							rejected = true;
+							break;
+						}
+					}
+				}
+			}
 
-	_params.degree = degree;
+			if (rejected)
+				continue;
 
-	int vnb = _voro->cells_number();
-	std::vector<double> steps(vnb, 0.0);
-	for (int i = 0; i < vnb; ++i)
-	{
-		const MyPolygonCell *cell = _voro->cell(i);
-		if (!cell)
-			continue;
+			next[s] = head[cj * gw + ci];
+			head[cj * gw + ci] = s;
+			taken[s] = 1;
+			accepted.push_back(s);
+		}
 
-		steps[i] = std::sqrt(cell->face_area(0)) * stepScale;
+		for (int s = 0; s < cnb && (int)accepted.size() < vnb; ++s)
+		{
+			if (!taken[s])
+				accepted.push_back(s);
+		}
 	}
-	
-	assign_pixels();
-	compute_polynomials();
-	double sumEnergy = compute_energies();
-	xlog("init energy = %f", sumEnergy);
-	
-	double sigma = 0.5;
-	std::vector<double> gradient(2 * vnb, 0.0);
-	for (int it = 0; it < iteration; ++it)
+	else
 	{
-		compute_gradients(&gradient[0], vnb);
-
-		double ri = double(it) / double(iteration - it);
-		
-		for (int v = 0; v < vnb; ++v)
-		{
-			double gnorm = 0.0;
-			gnorm += gradient[2 * v] * gradient[2 * v];
-			gnorm += gradient[2 * v + 1] * gradient[2 * v + 1];
-			gnorm = std::sqrt(gnorm);
-
-			if (gnorm == 0.0)
-				continue;
+		accepted.resize(vnb);
+		std::iota(accepted.begin(), accepted.end(), 0);
+	}
 
-			gradient[2 * v] /= gnorm;
-			gradient[2 * v + 1] /= gnorm;
+	_sites.clear();
+	_sites.resize(2 * vnb);
 
-			double delta = steps[v] * std::pow(sigma, ri);
+	for (int k = 0; k < vnb; ++k)
+	{
+		int s = accepted[k];
+		_sites[2 * k] = pool[2 * s] * _params.pixWidth - 1.0;
+		_sites[2 * k + 1] = pool[2 * s + 1] * _params.pixWidth - _params.ratio;
+	}
 
-			_sites[2 * v] -= delta * gradient[2 * v];
-			_sites[2 * v + 1] -= delta * gradient[2 * v + 1];
+	_weights.assign(vnb, 0.0);
 
-			// clamp
-			if (_sites[2 * v] < -1.0) _sites[2 * v] = -1.0;
-			if (_sites[2 * v] > 1.0)  _sites[2 * v] = 1.0;
-			if (_sites[2 * v + 1] < -_params.ratio) _sites[2 * v + 1] = -_params.ratio;
-			if (_sites[2 * v + 1] > _params.ratio) _sites[2 * v + 1] = _params.ratio;
-		}
-		
-		compute_voronoi();
-		assign_pixels();
-		compute_polynomials();
-		sumEnergy = compute_energies();
-		xlog("it = %d, energy = %f", it + 1, sumEnergy);
-	}
+	compute_voronoi();
 }
 
-void VoroApprox::approximate(int degree, unsigned char *output, int width, int height, int channel)
+/**
+* k-means in (x, y, color) seeded on a grid of spacing S, as SLIC, the centers become the sites
+* a pixel only compares the centers of the 3 x 3 grid slots around it, a center only gathers
+* the pixels of those slots, so both steps touch every pixel a bounded number of times
+* distance = |k (color - c)|^2 + (compactness / S)^2 |x - p|^2, k = 100 / 255 maps the 0 ... 255
+* channels to the 0 ... 100 range of CIELAB lightness, where the usual compactness of 10 is tuned
+*/
+void VoroApprox::slic_init(int vnb, int iteration /* = 10*/, double compactness /* = 10.0*/)
 {
-	if (!_params.image || !_voro || !output || channel > _params.channel)
+	if (!_params.image || vnb < 1)
 		return;
 
-	memset(output, 0, sizeof(unsigned char) * width * height * channel);
-
-	_params.degree = degree;
-
-	assign_pixels();
-	compute_polynomials();
-
-	int vnb = _voro->cells_number();
-
-	_pixels.clear();
-	_pixels.resize(vnb);
-
-	for (int v = 0; v < vnb; ++v)
+	int width = _params.width;
+	int height = _params.height;
+	int channel = _params.channel;
+
+	// slot k sits at (k % cols, k / cols), the last row may be partially filled
+	int cols = (std::max)(1, (std::min)(vnb, (int)std::ceil(std::sqrt(vnb / _params.ratio))));
+	int rows = (vnb + cols - 1) / cols;
+	double sx = double(width) / cols;
+	double sy = double(height) / rows;
+	double spacing = std::sqrt(sx * sy);
+
+	// the distance divided by k^2, so the channels are used as they are
+	double colorScale = 100.0 / 255.0;
+	double m2 = compactness * compactness / (spacing * spacing * colorScale * colorScale);
+
+	// x, y in pixels, then the channels
+	int dim = 2 + channel;
+	std::vector<double> centers(size_t(vnb) * dim);
+	for (int k = 0; k < vnb; ++k)
 	{
-		const MyPolygonCell *cell = _voro->cell(v);
-		if (!cell)
-			continue;
-
-		std::vector<double> polygon;
-		cell->face_polygon(0, polygon);
-		Rasterizer::rasterize(&polygon[0], (int)polygon.size() / 2, width, height, _pixels[v]);
+		double *ck = &centers[size_t(k) * dim];
+		ck[0] = (k % cols + 0.5) * sx;
+		ck[1] = (k / cols + 0.5) * sy;
+
+		int i = (std::min)((int)ck[0], width - 1);
+		int j = (std::min)((int)ck[1], height - 1);
+		for (int c = 0; c < channel; ++c)
+			ck[2 + c] = _planar.row(c, j)[i];
 	}
 
-	std::vector<double> approx(width * height * channel, 0.0);
-	std::vector<int> counts(width * height, 0);
-
-	double ratio = double(height) / width;
-	double pixWidth = double(2.0) / width;
-
-	for (int v = 0; v < vnb; ++v)
+	std::vector<int> labels(size_t(width) * height, 0);
+	for (int it = 0; it < iteration; ++it)
 	{
-		for (int j = _pixels[v].ymin; j <= _pixels[v].ymax; ++j)
+		// assignment, pixel parallel
+#pragma omp parallel for
+		for (int j = 0; j < height; ++j)
 		{
-			double y = pixWidth * (j + 0.5) - ratio;
-			int lineStart = j * width;
-
-			int loc = j - _pixels[v].ymin;
-			for (int i = _pixels[v].left[loc]; i <= _pixels[v].right[loc]; ++i)
+			int sj = (std::min)((int)(j / sy), rows - 1);
+			for (int i = 0; i < width; ++i)
 			{
-				double x = pixWidth * (i + 0.5) - 1.0;
-				int pixID = lineStart + i;
+				int si = (std::min)((int)(i / sx), cols - 1);
+				double x = i + 0.5;
+				double y = j + 0.5;
 
-				for (int c = 0; c < channel; ++c)
+				int best = -1;
+				double bestDist = DBL_MAX;
+				for (int bj = (std::max)(sj - 1, 0); bj <= (std::min)(sj + 1, rows - 1); ++bj)
 				{
-					approx[pixID * channel + c] += _polynomials[v].evaluate(c, x, y);
+					for (int bi = (std::max)(si - 1, 0); bi <= (std::min)(si + 1, cols - 1); ++bi)
+					{
+						int k = bj * cols + bi;
+						if (k >= vnb)
+							continue;
+
+						const double *ck = &centers[size_t(k) * dim];
+						double dx = x - ck[0];
+						double dy = y - ck[1];
+						double dist = m2 * (dx * dx + dy * dy);
+						for (int c = 0; c < channel && dist < bestDist; ++c)
+						{
+							double dc = _planar.row(c, j)[i] - ck[2 + c];
+							dist += dc * dc;
+						}
+
+						if (dist < bestDist)
+						{
+							bestDist = dist;
+							best = k;
+						}
+					}
 				}
 
-				++counts[pixID];
+				labels[size_t(j) * width + i] = best;
 			}
 		}
-	}
 
-	for (int j = 0; j < height; ++j)
-	{
-		double y = pixWidth * (j + 0.5) - ratio;
-		int lineStart = j * width;
+		// update, center parallel, an empty cluster keeps its center
+		double moved = 0.0;
 
-		for (int i = 0; i < width; ++i)
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:moved)
+		for (int k = 0; k < vnb; ++k)
 		{
-			double x = pixWidth * (i + 0.5) - 1.0;
-			int pixID = lineStart + i;
-
-			if (counts[pixID] < 1)
+			int si = k % cols;
+			int sj = k / cols;
+			int i0 = (int)((std::max)(si - 1, 0) * sx);
+			int i1 = (std::min)((int)std::ceil((std::min)(si + 2, cols) * sx), width);
+			int j0 = (int)((std::max)(sj - 1, 0) * sy);
+			int j1 = (std::min)((int)std::ceil((std::min)(sj + 2, rows) * sy), height);
+
+			double sum[2 + 4] = { 0.0 };
+			int count = 0;
+			for (int j = j0; j < j1; ++j)
 			{
-				continue;
+				for (int i = i0; i < i1; ++i)
+				{
+					if (labels[size_t(j) * width + i] != k)
+						continue;
+
+					sum[0] += i + 0.5;
+					sum[1] += j + 0.5;
+					for (int c = 0; c < channel; ++c)
+						sum[2 + c] += _planar.row(c, j)[i];
+					++count;
+				}
 			}
 
-			for (int c = 0; c < channel; ++c)
-			{
-				double avg = approx[pixID * channel + c] / counts[pixID];
-				if (avg > 255) avg = 255;
-				if (avg < 0) avg = 0;
+			if (count == 0)
+				continue;
 
-				output[pixID * channel + c] = unsigned char(avg);
-			}
+			double *ck = &centers[size_t(k) * dim];
+			double dx = sum[0] / count - ck[0];
+			double dy = sum[1] / count - ck[1];
+			moved += dx * dx + dy * dy;
+
+			for (int d = 0; d < dim; ++d)
+				ck[d] = sum[d] / count;
 		}
+
+		double rms = std::sqrt(moved / vnb);
+		xlog("it = %d, rms move = %f pixels", it + 1, rms);
+		if (rms < 0.1)
+			break;
 	}
-}
 
-void VoroApprox::sites_data(std::vector<float> &sites)
-{
-	sites.clear();
+	_sites.clear();
+	_sites.resize(2 * vnb);
 
-	for (auto it = _sites.begin(); it != _sites.end(); ++it)
-		sites.push_back(float(*it));
+	for (int k = 0; k < vnb; ++k)
+	{
+		_sites[2 * k] = centers[size_t(k) * dim] * _params.pixWidth - 1.0;
+		_sites[2 * k + 1] = centers[size_t(k) * dim + 1] * _params.pixWidth - _params.ratio;
+	}
+
+	_weights.assign(vnb, 0.0);
+
+	compute_voronoi();
 }
 
-void VoroApprox::voronoi_data(std::vector<float> &corners, std::vector<int> &edges)
+void VoroApprox::compute_voronoi()
 {
-	corners.clear();
+	if (_sites.empty() || !_params.image)
+		return;
+
+	double rect[8] = { -1, -_params.ratio, 1, -_params.ratio, 1, _params.ratio, -1, _params.ratio };
+
+	if (_params.powerDiagram)
+	{
+		if (!_rt)
+			_rt = new RegularTriangulation2D;
+
+		_weights.resize(sites_number(), 0.0);
+		_rt->set_vertices(&_sites[0], &_weights[0], sites_number());
+
+		if (!_power)
+		{
+			_power = new MyPowerDiagram;
+			_power->add_domain(rect, 4);
+		}
+
+		_power->compute(_rt);
+		++_diagramVersion;
+		return;
+	}
+
+	if (!_dt)
+		_dt = new DelaunayTriangulation2D;
+
+	_dt->set_vertices(&_sites[0], (int)_sites.size() / 2);
+
+	if (!_voro)
+	{
+		_voro = new MyVoronoi;
+		_voro->add_domain(rect, 4);
+	}
+
+	_voro->compute(_dt);
+	++_diagramVersion;
+}
+
+void VoroApprox::assign_pixels()
+{
+	if (discrete())
+	{
+		if (_sites.empty() || !_params.image)
+			return;
+
+		_labels.resize(_params.width * _params.height);
+
+		JumpFlood::compute(
+			&_sites[0],
+			sites_number(),
+			_params.width,
+			_params.height,
+			&_labels[0],
+			&_pixels,
+			&_floodWorkspace);
+
+		// labeled from the sites, not the diagram
+		_pixelsVersion = -1;
+		return;
+	}
+
+	if (!has_diagram())
+		return;
+
+	gather_polygons();
+
+	_labels.resize(_params.width * _params.height);
+
+	Rasterizer::rasterize(
+		&_polygons[0],
+		&_polygonOffsets[0],
+		(int)_polygonOffsets.size() - 1,
+		_params.width,
+		_params.height,
+		&_labels[0],
+		&_pixels,
+		&_rasterWorkspace);
+
+	_rasterPolygons = _polygons;
+	_rasterOffsets = _polygonOffsets;
+	_dirty.clear();
+	_pixelsVersion = _diagramVersion;
+}
+
+/**
+* a cell keeps its pixels unless its polygon changed, which happens when its site or a neighbor moved
+* the pixels a dirty cell gives up go to a dirty neighbor, so relabeling the dirty cells is enough
+*/
+// returns the number of rebuilt cells
+int VoroApprox::assign_dirty_pixels()
+{
+	int vnb = has_diagram() ? cells_number() : 0;
+	int pnb = _params.width * _params.height;
+
+	// the jump flood labels the whole image anyway
+	if (discrete() || vnb == 0 || _pixels.sets_number() != vnb ||
+		(int)_rasterOffsets.size() != vnb + 1 || (int)_labels.size() != pnb)
+	{
+		assign_pixels();
+		return _pixels.sets_number();
+	}
+
+	gather_polygons();
+
+	_dirty.assign(vnb, 0);
+	for (int v = 0; v < vnb; ++v)
+	{
+		int begin = _polygonOffsets[v], end = _polygonOffsets[v + 1];
+		int rbegin = _rasterOffsets[v], rend = _rasterOffsets[v + 1];
+
+		if (end - begin != rend - rbegin ||
+			!std::equal(_polygons.begin() + 2 * begin, _polygons.begin() + 2 * end, _rasterPolygons.begin() + 2 * rbegin))
+			_dirty[v] = 1;
+	}
+
+	int count = 0;
+	for (int v = 0; v < vnb; ++v)
+	{
+		if (!_dirty[v])
+			continue;
+
+		int begin = _polygonOffsets[v];
+		Rasterizer::rasterize(&_polygons[2 * begin], _polygonOffsets[v + 1] - begin, _params.width, _params.height, _pixels, v);
+
+		PixelSet pixels = _pixels[v];
+		for (int j = pixels.ymin; j <= pixels.ymax; ++j)
+		{
+			int loc = j - pixels.ymin;
+			if (pixels.left[loc] <= pixels.right[loc])
+				std::fill(&_labels[j * _params.width + pixels.left[loc]], &_labels[j * _params.width + pixels.right[loc]] + 1, v);
+		}
+
+		++count;
+	}
+
+	// rebuilt sets leave stale rows behind
+	if (_pixels.garbage() > _pixels.rows_number() / 2)
+		_pixels.compact();
+
+	_rasterPolygons = _polygons;
+	_rasterOffsets = _polygonOffsets;
+	_pixelsVersion = _diagramVersion;
+
+	return count;
+}
+
+void VoroApprox::gather_polygons()
+{
+	_polygons.clear();
+	_polygonOffsets.clear();
+	_polygonOffsets.push_back(0);
+
+	int vnb = cells_number();
+	for (int i = 0; i < vnb; ++i)
+	{
+		MyPolygonCell cell = this->cell(i);
+		if (cell.faces_number() > 0)
+		{
+			const double *begin = cell.point(cell.face_begin(0));
+			_polygons.insert(_polygons.end(), begin, begin + 2 * cell.face_size(0));
+		}
+
+		_polygonOffsets.push_back((int)_polygons.size() / 2);
+	}
+
+	// keep &_polygons[0] valid for diagrams without any polygon
+	if (_polygons.empty())
+		_polygons.resize(2, 0.0);
+}
+
+void VoroApprox::compute_polynomials()
+{
+	if (!_params.image || _pixels.empty())
+		return;
+
+	int vnb = _pixels.sets_number();
+
+	// fits of another layout or cell count are all stale, and so are sampled fits
+	if (_coefficients.cells_number() != vnb || _coefficients.degree() != _params.degree || _coefficients.channel() != _params.channel)
+		_dirty.clear();
+	if (_sampleStep > 1 || _fitStep > 1)
+		_dirty.clear();
+
+	_fitStep = _sampleStep;
+
+	_coefficients.set_layout(_params.degree, _params.channel);
+	_coefficients.resize(vnb);
+
+	MyKernels::FitPlanar fit = MyKernels::fit_planar(_params.degree, _params.channel);
+
+	// adaptive[d] picks among degrees 0 ... d
+	MyKernels::FitAdaptive adaptive[Legendre::MaxDegree + 1] = { NULL };
+	if (_params.adaptiveDegree)
+	{
+		for (int d = 0; d <= _params.degree; ++d)
+			adaptive[d] = MyKernels::fit_adaptive(d, _params.channel);
+	}
+
+	MyKernels::FitSampled sampled[Legendre::MaxDegree + 1] = { NULL };
+	if (_sampleStep > 1)
+	{
+		for (int d = 0; d <= _params.degree; ++d)
+			sampled[d] = MyKernels::fit_sampled(d, _params.channel);
+	}
+
+	double cost = _params.degreeCost * _params.pixArea;
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for (int i = 0; i < vnb; ++i)
+	{
+		// a clean cell keeps its fit, unless its degree may still climb
+		bool climbing = adaptive[0] && _coefficients.degree(i) < _params.degree;
+		if (clean(i) && !climbing)
+			continue;
+
+		if (!_dirty.empty())
+			_dirty[i] = 1;
+
+		PixelSet pixels = _pixels[i];
+
+		// the degree is kept, it is only chosen on all pixels
+		// cells with a few samples per coefficient take all pixels
+		int degree = _coefficients.degree(i);
+		if (sampled[degree] && pixels.area() >= 4 * Legendre::terms_number(degree) * _sampleStep * _sampleStep)
+		{
+			PixelSample sample = cell_sample(i, 0);
+
+			double coeff[4 * Legendre::MaxTerms], transform[3];
+			sampled[degree](_planar, &pixels, &sample, coeff, transform);
+			_coefficients.set(i, coeff, transform, degree);
+			continue;
+		}
+
+		// the degree moves up at most one step per fit, so the gram matrix
+		// only covers one degree above the previous choice
+		int top = (std::min)(_coefficients.degree(i) + 1, _params.degree);
+		if (adaptive[top])
+		{
+			double coeff[4 * Legendre::MaxTerms], transform[3];
+			int degree = 0;
+			adaptive[top](_planar, &pixels, cost, coeff, transform, &degree);
+			_coefficients.set(i, coeff, transform, degree);
+			continue;
+		}
+
+		if (fit)
+		{
+			double coeff[4 * Legendre::MaxTerms], transform[3];
+			fit(_planar, &pixels, coeff, transform);
+			_coefficients.set(i, coeff, transform);
+			continue;
+		}
+
+		MyPolynomial polynomial(_params.degree);
+		polynomial.compute_factors(
+			_params.image,
+			_params.width,
+			_params.height,
+			_params.channel,
+			&pixels);
+
+		_coefficients.set(i, polynomial.coefficients(), polynomial.transform());
+	}
+
+	// sampled fits are not reused
+	_fitVersion = _fitStep == 1 ? _pixelsVersion : -1;
+}
+
+double VoroApprox::compute_energies()
+{
+	if (!_params.image || _pixels.empty() || _coefficients.empty())
+		return 1e10;
+
+	double sum = 0.0;
+
+	int vnb = _pixels.sets_number();
+	if ((int)_energies.size() != vnb)
+		_dirty.clear();
+
+	_energies.resize(vnb);
+
+	MyKernels::EnergyPlanar energy[Legendre::MaxDegree + 1] = { NULL };
+	MyKernels::EnergySampled sampled[Legendre::MaxDegree + 1] = { NULL };
+	for (int d = 0; d <= _coefficients.degree(); ++d)
+	{
+		energy[d] = MyKernels::energy_planar(d, _params.channel);
+		if (_sampleStep > 1)
+			sampled[d] = MyKernels::energy_sampled(d, _params.channel);
+	}
+
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:sum)
+	for (int i = 0; i < vnb; ++i)
+	{
+		if (clean(i))
+		{
+			sum += _energies[i];
+			continue;
+		}
+
+		PixelSet pixels = _pixels[i];
+
+		// scored on other pixels than the fit saw, so the estimate is not biased low
+		int degree = _coefficients.degree(i);
+		if (sampled[degree] && pixels.area() >= 4 * Legendre::terms_number(degree) * _sampleStep * _sampleStep)
+		{
+			PixelSample sample = cell_sample(i, 1);
+
+			double coeff[4 * Legendre::MaxTerms], transform[3];
+			_coefficients.get(i, coeff, transform);
+			_energies[i] = sampled[degree](coeff, transform, _planar, &pixels, &sample, _params.Lp);
+
+			sum += _energies[i];
+			continue;
+		}
+
+		MyKernels::EnergyPlanar cellEnergy = energy[degree];
+		if (cellEnergy)
+		{
+			double coeff[4 * Legendre::MaxTerms], transform[3];
+			_coefficients.get(i, coeff, transform);
+			_energies[i] = cellEnergy(coeff, transform, _planar, &pixels, _params.Lp);
+
+			sum += _energies[i];
+			continue;
+		}
+
+		_energies[i] = _coefficients.compute_energy(
+			i,
+			_params.image,
+			_params.width,
+			_params.height,
+			_params.channel,
+			&pixels,
+			_params.Lp);
+
+		sum += _energies[i];
+	}
+
+	return sum;
+}
+
+/**
+* g holds the position gradient, gw (if given) the weight gradient of the power diagram
+* a boundary point x of cells a and b moves along the normal by (x - a) . da / |b - a|
+* and by dw_a / (2 |b - a|) for the weight
+*/
+void VoroApprox::compute_gradients(double *g, int n, double *gw /* = NULL*/)
+{
+	if (!_params.image)
+		return;
+
+	if (_params.labelGradient || discrete())
+	{
+		compute_label_gradients(g, n, gw);
+		return;
+	}
+
+	if (!has_diagram())
+		return;
+
+	assert(n == cells_number());
+
+	_samples.clear();
+
+	for (int v = 0; v < n; ++v)
+	{
+		MyPolygonCell cell = this->cell(v);
+		if (cell.faces_number() < 1)
+			continue;
+
+		for (int i = cell.face_begin(0); i < cell.face_end(0); ++i)
+		{
+			int nv = cell.point_flag(i);
+			if (nv < 0)
+				continue;
+
+			int next = cell.next_around_face(0, i);
+			sample_edge(v, nv, cell.point(i), cell.point(next));
+		}
+	}
+
+	evaluate_samples();
+
+	memset(g, 0, sizeof(double) * 2 * n);
+	if (gw)
+		memset(gw, 0, sizeof(double) * n);
+
+	int snb = _samples.size();
+	for (int k = 0; k < snb; ++k)
+	{
+		int a = _samples.cellA[k];
+		const double *A = &_sites[2 * a];
+
+		double energyDiff = (_samples.energyA[k] - _samples.energyB[k]) * _samples.weight[k];
+
+		g[2 * a] += energyDiff * (_samples.x[k] - A[0]);
+		g[2 * a + 1] += energyDiff * (_samples.y[k] - A[1]);
+
+		// the sample weight already holds 1 / |b - a|
+		if (gw)
+			gw[a] += 0.5 * energyDiff;
+	}
+}
+
+/**
+* moves sites from where they are least needed to where the error is
+* a split inserts the cell corner farthest from the site, as greedy_init
+* a merge removes a site whose cell and best neighbor fit well as one cell,
+* the cost is the energy the union fit adds
+* cells are assumed to match the current sites, returns the number of split/merge pairs done
+*/
+int VoroApprox::adapt_sites()
+{
+	if (!_params.image || !has_diagram() || _pixels.empty())
+		return 0;
+
+	MyKernels::UnionEnergy unionEnergy = MyKernels::union_energy(_params.degree, _params.channel);
+	if (!unionEnergy)
+		return 0;
+
+	// the discrete mode does not keep the diagram up to date
+	if (discrete())
+		compute_voronoi();
+
+	int vnb = sites_number();
+	if ((int)_energies.size() != vnb || cells_number() != vnb)
+		return 0;
+
+	int count = (std::max)(1, int(vnb * _params.adaptFraction));
+	count = (std::min)(count, vnb / 2);
+
+	// split candidates, highest energy first
+	std::vector<int> order(vnb);
+	std::iota(order.begin(), order.end(), 0);
+	std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](int a, int b)
+	{
+		return _energies[a] > _energies[b];
+	});
+
+	std::vector<char> locked(vnb, 0);
+	for (int i = 0; i < count; ++i)
+		locked[order[i]] = 1;
+
+	std::vector<double> mergeCost(vnb, DBL_MAX);
+	std::vector<int> mergeInto(vnb, -1);
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for (int v = 0; v < vnb; ++v)
+	{
+		if (locked[v])
+			continue;
+
+		MyPolygonCell cell = this->cell(v);
+		if (cell.faces_number() < 1)
+			continue;
+
+		PixelSet pixels = _pixels[v];
+		for (int i = cell.face_begin(0); i < cell.face_end(0); ++i)
+		{
+			int nv = cell.point_flag(i);
+			if (nv < 0 || locked[nv])
+				continue;
+
+			PixelSet neighbor = _pixels[nv];
+			double cost = unionEnergy(_planar, &pixels, &neighbor) - _energies[v] - _energies[nv];
+			if (cost < mergeCost[v])
+			{
+				mergeCost[v] = cost;
+				mergeInto[v] = nv;
+			}
+		}
+	}
+
+	std::vector<int> merges;
+	for (int v = 0; v < vnb; ++v)
+	{
+		if (mergeInto[v] >= 0)
+			merges.push_back(v);
+	}
+
+	std::sort(merges.begin(), merges.end(), [&](int a, int b)
+	{
+		return mergeCost[a] < mergeCost[b];
+	});
+
+	// pair the i-th split with the i-th cheapest merge among cells not touched yet
+	// new sites go to the back, existing indices stay
+	std::vector<int> removed;
+
+	int m = 0, mnb = (int)merges.size();
+	for (int i = 0; i < count; ++i)
+	{
+		int s = order[i];
+
+		while (m < mnb && (locked[merges[m]] || locked[mergeInto[merges[m]]]))
+			++m;
+
+		if (m == mnb)
+			break;
+
+		// a split removes at most the energy of the cell
+		int v = merges[m];
+		if (mergeCost[v] >= _energies[s])
+			break;
+
+		// neighboring splits can share a corner, only a new site pays for a merge
+		double p[2];
+		if (!farthest_corner(s, p) || !add_site(p))
+			continue;
+
+		locked[v] = 1;
+		locked[mergeInto[v]] = 1;
+		removed.push_back(v);
+	}
+
+	if (removed.empty())
+		return 0;
+
+	// removing from the back keeps the pending indices valid
+	std::sort(removed.begin(), removed.end(), std::greater<int>());
+	for (auto it = removed.begin(); it != removed.end(); ++it)
+		remove_site(*it);
+
+	update_diagram();
+
+	return (int)removed.size();
+}
+
+// new sites start with zero weight, false for a duplicate point
+bool VoroApprox::add_site(const double *p)
+{
+	if (_params.powerDiagram)
+	{
+		int before = _rt->vertices_number();
+		_rt->add_vertex(p, 0.0);
+		if (_rt->vertices_number() == before)
+			return false;
+	}
+	else
+	{
+		int before = _dt->vertices_number();
+		_dt->add_vertex(p);
+		if (_dt->vertices_number() == before)
+			return false;
+	}
+
+	_sites.push_back(p[0]);
+	_sites.push_back(p[1]);
+	_weights.push_back(0.0);
+	_coefficients.add_cell();
+
+	return true;
+}
+
+// the last site takes over index v
+void VoroApprox::remove_site(int v)
+{
+	if (_params.powerDiagram)
+		_rt->remove_vertex(v);
+	else
+		_dt->remove_vertex(v);
+
+	_coefficients.remove_cell(v);
+
+	int last = sites_number() - 1;
+	_sites[2 * v] = _sites[2 * last];
+	_sites[2 * v + 1] = _sites[2 * last + 1];
+	_sites.resize(2 * last);
+
+	_weights[v] = _weights[last];
+	_weights.resize(last);
+}
+
+void VoroApprox::update_diagram()
+{
+	if (_params.powerDiagram)
+		_power->compute(_rt);
+	else
+		_voro->compute(_dt);
+
+	++_diagramVersion;
+}
+
+void VoroApprox::sample_edge(
+	int a,
+	int b,
+	const double *source,
+	const double *target)
+{
+	const double *A = &_sites[2 * a];
+	const double *B = &_sites[2 * b];
+
+	double dx = source[0] - target[0];
+	double dy = source[1] - target[1];
+	double length = std::sqrt(dx * dx + dy * dy);
+	int n = int(length / _params.pixWidth + 0.5);
+	if (n < 1)
+		return;
+
+	dx = B[0] - A[0];
+	dy = B[1] - A[1];
+	double distance = std::sqrt(dx * dx + dy * dy);
+
+	double ds = length / n / distance;
+	int n2 = 2 * n;
+	for (int s = 1; s < n2; s += 2)
+	{
+		double lamda = double(s) / n2;
+		double p[2];
+		p[0] = source[0] * (1.0 - lamda) + target[0] * lamda;
+		p[1] = source[1] * (1.0 - lamda) + target[1] * lamda;
+
+		int i = -1, j = -1;
+		locate_point(p, i, j);
+
+		int pixID = j * _params.width + i;
+		_samples.add(a, b, pixID, pixID, p, ds);
+	}
+}
+
+void VoroApprox::evaluate_samples()
+{
+	int snb = _samples.size();
+
+	_samples.energyA.assign(snb, 0.0);
+	_samples.energyB.assign(snb, 0.0);
+	_samples.values.resize(snb);
+
+	if (snb == 0)
+		return;
+
+	const double *x = &_samples.x[0];
+	const double *y = &_samples.y[0];
+	double *values = &_samples.values[0];
+
+	int channel = _params.channel;
+	for (int c = 0; c < channel; ++c)
+	{
+		_coefficients.evaluate(c, snb, &_samples.cellA[0], x, y, values);
+		for (int k = 0; k < snb; ++k)
+		{
+			double pixVal = 0.5 * (double(_params.image[channel * _samples.pixA[k] + c])
+				+ double(_params.image[channel * _samples.pixB[k] + c]));
+
+			double diff = pixVal - values[k];
+			_samples.energyA[k] += diff * diff;
+		}
+
+		_coefficients.evaluate(c, snb, &_samples.cellB[0], x, y, values);
+		for (int k = 0; k < snb; ++k)
+		{
+			double pixVal = 0.5 * (double(_params.image[channel * _samples.pixA[k] + c])
+				+ double(_params.image[channel * _samples.pixB[k] + c]));
+
+			double diff = pixVal - values[k];
+			_samples.energyB[k] += diff * diff;
+		}
+	}
+}
+
+void VoroApprox::compute_label_gradients(double *g, int n, double *gw)
+{
+	// assign_pixels labels every pixel in both modes, only greedy_init leaves no labels
+	if ((int)_labels.size() != _params.width * _params.height)
+		assign_pixels();
+
+	_samples.clear();
+
+	int width = _params.width;
+	int height = _params.height;
+
+	// one streaming sweep, each boundary between 4-neighbors is visited once
+	for (int j = 0; j < height; ++j)
+	{
+		double p[2];
+		p[1] = _params.pixWidth * (j + 0.5) - _params.ratio;
+
+		int lineStart = j * width;
+		for (int i = 0; i < width; ++i)
+		{
+			int pixID = lineStart + i;
+			int a = _labels[pixID];
+			if (a < 0)
+				continue;
+
+			if (i + 1 < width)
+			{
+				int b = _labels[pixID + 1];
+				if (b >= 0 && b != a)
+				{
+					double q[2] = { _params.pixWidth * (i + 1.0) - 1.0, p[1] };
+					sample_label_pair(a, b, pixID, pixID + 1, q, true);
+				}
+			}
+
+			if (j + 1 < height)
+			{
+				int b = _labels[pixID + width];
+				if (b >= 0 && b != a)
+				{
+					double q[2] = { _params.pixWidth * (i + 0.5) - 1.0, _params.pixWidth * (j + 1.0) - _params.ratio };
+					sample_label_pair(a, b, pixID, pixID + width, q, false);
+				}
+			}
+		}
+	}
+
+	evaluate_samples();
+
+	memset(g, 0, sizeof(double) * 2 * n);
+	if (gw)
+		memset(gw, 0, sizeof(double) * n);
+
+	int snb = _samples.size();
+	for (int k = 0; k < snb; ++k)
+	{
+		int a = _samples.cellA[k];
+		int b = _samples.cellB[k];
+		const double *A = &_sites[2 * a];
+		const double *B = &_sites[2 * b];
+
+		double energyDiff = (_samples.energyA[k] - _samples.energyB[k]) * _samples.weight[k];
+		double p[2] = { _samples.x[k], _samples.y[k] };
+
+		g[2 * a] += energyDiff * (p[0] - A[0]);
+		g[2 * a + 1] += energyDiff * (p[1] - A[1]);
+		g[2 * b] -= energyDiff * (p[0] - B[0]);
+		g[2 * b + 1] -= energyDiff * (p[1] - B[1]);
+
+		if (gw)
+		{
+			gw[a] += 0.5 * energyDiff;
+			gw[b] -= 0.5 * energyDiff;
+		}
+	}
+}
+
+void VoroApprox::sample_label_pair(
+	int a,
+	int b,
+	int pixA,
+	int pixB,
+	const double *p,
+	bool horizontal)
+{
+	const double *A = &_sites[2 * a];
+	const double *B = &_sites[2 * b];
+
+	double dx = B[0] - A[0];
+	double dy = B[1] - A[1];
+	double length = std::sqrt(dx * dx + dy * dy);
+	if (length == 0.0)
+		return;
+
+	// a pixel pair crossing stands for the part of edge AB whose projection
+	// onto the pair direction is one pixel wide
+	double ds = _params.pixWidth * std::fabs(horizontal ? dx : dy) / length;
+
+	_samples.add(a, b, pixA, pixB, p, ds / length);
+}
+
+void VoroApprox::locate_point(const double *p, int &i, int &j) const
+{
+	double x = 0.5 * (p[0] + 1.0) / 1.0;
+	double y = 0.5 * (p[1] + _params.ratio) / _params.ratio;
+
+	x = (std::max)(0.0, x);
+	x = (std::min)(1.0, x);
+	y = (std::max)(0.0, y);
+	y = (std::min)(1.0, y);
+
+	i = (int)floor(x * double(_params.width));
+	j = (int)floor(y * double(_params.height));
+
+	if (i == _params.width) --i;
+	if (j == _params.height) --j;
+}
+
+// the farthest corner of the cell of v from the site
+bool VoroApprox::farthest_corner(int v, double *p) const
+{
+	MyPolygonCell cell = this->cell(v);
+	if (cell.faces_number() < 1)
+		return false;
+
+	const double *maxP = NULL;
+	double maxDist = 0;
+
+	for (int i = cell.face_begin(0); i < cell.face_end(0); ++i)
+	{
+		const double *q = cell.point(i);
+		double dx = q[0] - _sites[2 * v];
+		double dy = q[1] - _sites[2 * v + 1];
+		double dist = dx * dx + dy * dy;
+
+		if (dist > maxDist)
+		{
+			maxDist = dist;
+			maxP = q;
+		}
+	}
+
+	if (!maxP)
+		return false;
+
+	p[0] = maxP[0];
+	p[1] = maxP[1];
+	return true;
+}
+
+void VoroApprox::compute_steps(std::vector<double> &steps, double stepScale) const
+{
+	int vnb = sites_number();
+	steps.assign(vnb, 0.0);
+
+	for (int i = 0; i < vnb; ++i)
+	{
+		if (discrete())
+		{
+			steps[i] = std::sqrt(_pixels[i].area() * _params.pixArea) * stepScale;
+			continue;
+		}
+
+		MyPolygonCell cell = this->cell(i);
+		if (cell.faces_number() < 1)
+			continue;
+
+		steps[i] = std::sqrt(cell.face_area(0)) * stepScale;
+	}
+}
+
+void VoroApprox::optimize(int degree, int iteration, double stepScale /* = 0.3*/)
+{
+	if (!_params.image || !has_diagram())
+		return;
+
+	_params.degree = degree;
+
+	assign_pixels();
+
+	int vnb = sites_number();
+	std::vector<double> steps;
+	compute_steps(steps, stepScale);
+
+	compute_polynomials();
+	double sumEnergy = compute_energies();
+	xlog("init energy = %f", sumEnergy);
+	
+	double sigma = 0.5;
+	std::vector<double> gradient(2 * vnb, 0.0);
+	std::vector<double> weightGradient;
+
+	// iterations in a row each site stayed below the freeze threshold
+	std::vector<int> still(vnb, 0);
+	std::vector<int> reseated;
+	for (int it = 0; it < iteration; ++it)
+	{
+#ifdef VOROAPPROX_COUNT_ALLOCATIONS
+		long long allocations = alloc_count();
+#endif
+
+		double *gw = NULL;
+		if (_params.powerDiagram)
+		{
+			weightGradient.resize(vnb);
+			gw = &weightGradient[0];
+		}
+
+		compute_gradients(&gradient[0], vnb, gw);
+
+		double ri = double(it) / double(iteration - it);
+		int frozen = 0;
+
+		_sampleStep = sample_step(it, iteration);
+		++_sampleRound;
+		
+		for (int v = 0; v < vnb; ++v)
+		{
+			// a weight change dw moves the boundary by about dw / (2 size),
+			// the weight is measured in units of size / 2 so it steps slower than the site
+			double size = steps[v] / stepScale;
+			double gscaled = gw ? gw[v] * 0.5 * size : 0.0;
+
+			double gnorm = 0.0;
+			gnorm += gradient[2 * v] * gradient[2 * v];
+			gnorm += gradient[2 * v + 1] * gradient[2 * v + 1];
+			gnorm += gscaled * gscaled;
+			gnorm = std::sqrt(gnorm);
+
+			// the energy a full step would remove, against the mean cell energy
+			if (_params.freezeThreshold > 0.0)
+			{
+				if (gnorm * steps[v] < _params.freezeThreshold * sumEnergy / vnb)
+					++still[v];
+				else
+					still[v] = 0;
+
+				if (still[v] >= _params.freezeIterations)
+				{
+					++frozen;
+					continue;
+				}
+			}
+
+			if (gnorm == 0.0)
+				continue;
+
+			gradient[2 * v] /= gnorm;
+			gradient[2 * v + 1] /= gnorm;
+
+			double delta = steps[v] * std::pow(sigma, ri);
+
+			if (gw)
+			{
+				// bounded so cells do not swallow their neighbors
+				double limit = size * size;
+				_weights[v] -= delta * gscaled / gnorm * 0.5 * size;
+				_weights[v] = (std::max)(-limit, (std::min)(limit, _weights[v]));
+			}
+
+			_sites[2 * v] -= delta * gradient[2 * v];
+			_sites[2 * v + 1] -= delta * gradient[2 * v + 1];
+
+			// clamp
+			if (_sites[2 * v] < -1.0) _sites[2 * v] = -1.0;
+			if (_sites[2 * v] > 1.0)  _sites[2 * v] = 1.0;
+			if (_sites[2 * v + 1] < -_params.ratio) _sites[2 * v + 1] = -_params.ratio;
+			if (_sites[2 * v + 1] > _params.ratio) _sites[2 * v + 1] = _params.ratio;
+		}
+		
+		if (!discrete())
+			compute_voronoi();
+
+		// a hidden site has no gradient, it would never come back on its own
+		// reseated as adapt_sites moves sites, so they have iterations left to settle
+		bool reseat = (it + 1) % _params.adaptPeriod == 0 && 2 * (it + 1) <= iteration;
+		if (reseat && reseat_hidden_sites(reseated) > 0)
+		{
+			for (size_t k = 0; k < reseated.size(); ++k)
+				still[reseated[k]] = 0;
+
+			xlog("it = %d, reseated hidden sites = %d", it + 1, (int)reseated.size());
+		}
+
+		int dirty = vnb;
+		if (_params.dirtyCells)
+			dirty = assign_dirty_pixels();
+		else
+			assign_pixels();
+		compute_polynomials();
+		sumEnergy = compute_energies();
+		xlog("it = %d, energy = %f, dirty cells = %d / %d", it + 1, sumEnergy, dirty, vnb);
+
+		if (_sampleStep > 1)
+			xlog("it = %d, sampled 1 / %d of the pixels", it + 1, _sampleStep * _sampleStep);
+
+		if (_params.freezeThreshold > 0.0)
+			xlog("it = %d, frozen sites = %d", it + 1, frozen);
+
+		if (_params.adaptiveDegree)
+			xlog("it = %d, coefficients = %d", it + 1, _coefficients.coefficients_number());
+
+		if (_params.tolerance > 0.0 && _sampleStep == 1 && max_cell_error() <= _params.tolerance)
+			break;
+
+		// late moves have no iterations left to settle
+		if (_params.adaptiveSites && (it + 1) % _params.adaptPeriod == 0 && 2 * (it + 1) <= iteration)
+		{
+			int moved = adapt_sites();
+			if (moved > 0)
+			{
+				vnb = sites_number();
+				gradient.resize(2 * vnb);
+				still.assign(vnb, 0);
+
+				assign_pixels();
+				compute_steps(steps, stepScale);
+				compute_polynomials();
+				sumEnergy = compute_energies();
+				xlog("it = %d, moved sites = %d, energy = %f", it + 1, moved, sumEnergy);
+			}
+		}
+
+#ifdef VOROAPPROX_COUNT_ALLOCATIONS
+		xlog("it = %d, heap allocations = %lld", it + 1, alloc_count() - allocations);
+#endif
+	}
+
+	_sampleStep = 1;
+
+	// the geometric diagram is still needed for display and output
+	if (discrete())
+		compute_voronoi();
+}
+
+// the sample rate climbs geometrically from minSampleRate to 1 over the first half of the run
+int VoroApprox::sample_step(int it, int iteration) const
+{
+	if (_params.minSampleRate >= 1.0 || 2 * it >= iteration - 1)
+		return 1;
+
+	double t = 2.0 * it / (iteration - 1);
+	double rate = std::pow((std::max)(_params.minSampleRate, 1e-4), 1.0 - t);
+
+	return (std::max)(1, int(1.0 / std::sqrt(rate)));
+}
+
+// offsets drawn per cell and round, salt tells the fit and the energy samples apart
+PixelSample VoroApprox::cell_sample(int v, int salt) const
+{
+	unsigned int h = unsigned(v) * 2654435761u ^ unsigned(2 * _sampleRound + salt) * 2246822519u;
+	h ^= h >> 15;
+	h *= 2246822519u;
+	h ^= h >> 13;
+
+	return PixelSample(_sampleStep, h % _sampleStep, (h / _sampleStep) % _sampleStep);
+}
+
+/**
+* each pass tries a step for the sites of one color class in parallel, only reading the state,
+* then applies the improving moves one by one, skipping a move whose cells or sites an applied
+* move of the same pass changed, so every applied move lowers the local energy it measured
+* the distance-2 coloring keeps those conflicts rare
+* the local oracle clips cells itself, so its pixels can differ from the diagram's at the borders,
+* a sweep that raises the energy of the diagram is undone and retried with half the step,
+* a few failures in a row end the optimization
+*/
+void VoroApprox::optimize_local(int degree, int iteration, double stepScale /* = 0.3*/)
+{
+	if (!_params.image || !has_diagram())
+		return;
+
+	_params.degree = degree;
+
+	compute_voronoi();
+	assign_pixels();
+	compute_polynomials();
+	double sumEnergy = compute_energies();
+	xlog("init energy = %f", sumEnergy);
+
+	// moves keep every cell, so hidden power sites only come back here
+	std::vector<int> reseated;
+	if (reseat_hidden_sites(reseated) > 0)
+	{
+		assign_pixels();
+		compute_polynomials();
+		sumEnergy = compute_energies();
+		xlog("reseated hidden sites = %d, energy = %f", (int)reseated.size(), sumEnergy);
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	if ((int)_localWorkspaces.size() < threads)
+		_localWorkspaces.resize(threads);
+
+	int vnb = sites_number();
+	double sigma = 0.5;
+	std::vector<double> gradient(2 * vnb, 0.0);
+	std::vector<double> steps;
+	std::vector<double> start;
+	std::vector<int> classStart, classSites;
+	std::vector<LocalMove> moves;
+
+	// pass in which a cell last changed or a site last moved
+	std::vector<int> cellStamp(vnb, -1), siteStamp(vnb, -1);
+	int pass = 0;
+
+	const int maxFailures = 3;
+	int failures = 0, undone = 0;
+
+	for (int it = 0; it < iteration; ++it)
+	{
+		compute_steps(steps, stepScale);
+		compute_gradients(&gradient[0], vnb);
+
+		build_neighbors();
+		int cnb = color_sites(classStart, classSites);
+
+		start = _sites;
+		double ri = double(it) / double(iteration - it);
+		int applied = 0;
+
+		for (int k = 0; k < cnb; ++k, ++pass)
+		{
+			int first = classStart[k];
+			int count = classStart[k + 1] - first;
+			if ((int)moves.size() < count)
+				moves.resize(count);
+
+#pragma omp parallel for schedule(dynamic, 16)
+			for (int s = 0; s < count; ++s)
+			{
+				int thread = 0;
+#ifdef _OPENMP
+				thread = omp_get_thread_num();
+#endif
+				LocalWorkspace &ws = _localWorkspaces[thread];
+
+				int v = classSites[first + s];
+				LocalMove &move = moves[s];
+				move.accepted = false;
+
+				double gnorm = std::sqrt(gradient[2 * v] * gradient[2 * v] + gradient[2 * v + 1] * gradient[2 * v + 1]);
+				if (gnorm == 0.0)
+					continue;
+
+				// the step of optimize(), halved while it does not pay off
+				double delta = steps[v] * std::pow(sigma, ri);
+				for (int t = 0; t < 3; ++t, delta *= 0.5)
+				{
+					move.q[0] = _sites[2 * v] - delta * gradient[2 * v] / gnorm;
+					move.q[1] = _sites[2 * v + 1] - delta * gradient[2 * v + 1] / gnorm;
+
+					move.q[0] = (std::max)(-1.0, (std::min)(1.0, move.q[0]));
+					move.q[1] = (std::max)(-_params.ratio, (std::min)(_params.ratio, move.q[1]));
+
+					if (local_move(v, move.q, ws, move) && move.after < move.before)
+					{
+						move.accepted = true;
+						break;
+					}
+				}
+			}
+
+			for (int s = 0; s < count; ++s)
+			{
+				LocalMove &move = moves[s];
+				if (!move.accepted)
+					continue;
+
+				bool conflict = false;
+				for (size_t c = 0; c < move.cells.size() && !conflict; ++c)
+					conflict = cellStamp[move.cells[c]] == pass;
+				for (size_t r = 0; r < move.reads.size() && !conflict; ++r)
+					conflict = siteStamp[move.reads[r]] == pass;
+
+				if (conflict)
+					continue;
+
+				int v = classSites[first + s];
+				_sites[2 * v] = move.q[0];
+				_sites[2 * v + 1] = move.q[1];
+				siteStamp[v] = pass;
+
+				for (size_t c = 0; c < move.cells.size(); ++c)
+				{
+					int cell = move.cells[c];
+					_neighbors[cell].assign(
+						move.neighbors.begin() + move.neighborStart[c],
+						move.neighbors.begin() + move.neighborStart[c + 1]);
+					cellStamp[cell] = pass;
+				}
+
+				++applied;
+			}
+		}
+
+		double lastEnergy = sumEnergy;
+
+		compute_voronoi();
+		if (_params.dirtyCells)
+			assign_dirty_pixels();
+		else
+			assign_pixels();
+		compute_polynomials();
+		sumEnergy = compute_energies();
+		xlog("it = %d, energy = %f, colors = %d, applied moves = %d", it + 1, sumEnergy, cnb, applied);
+
+		if (sumEnergy > lastEnergy)
+		{
+			_sites = start;
+
+			compute_voronoi();
+			if (_params.dirtyCells)
+				assign_dirty_pixels();
+			else
+				assign_pixels();
+			compute_polynomials();
+			sumEnergy = compute_energies();
+
+			++undone;
+			stepScale *= 0.5;
+			xlog("it = %d, sweep undone, step scale = %f, energy = %f", it + 1, stepScale, sumEnergy);
+
+			if (++failures == maxFailures)
+				break;
+
+			continue;
+		}
+
+		failures = 0;
+		if (applied == 0)
+			break;
+	}
+
+	xlog("undone sweeps = %d", undone);
+}
+
+void VoroApprox::build_neighbors()
+{
+	int vnb = sites_number();
+	_neighbors.resize(vnb);
+
+	for (int v = 0; v < vnb; ++v)
+	{
+		std::vector<int> &neighbors = _neighbors[v];
+		neighbors.clear();
+
+		MyPolygonCell cell = this->cell(v);
+		if (cell.faces_number() > 0)
+		{
+			for (int i = cell.face_begin(0); i < cell.face_end(0); ++i)
+			{
+				if (cell.point_flag(i) > -1)
+					neighbors.push_back(cell.point_flag(i));
+			}
+		}
+
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	}
+}
+
+// greedy distance-2 coloring, class k is classSites[classStart[k]] ... , returns the number of classes
+int VoroApprox::color_sites(std::vector<int> &classStart, std::vector<int> &classSites) const
+{
+	int vnb = sites_number();
+	std::vector<int> colors(vnb, -1);
+	std::vector<int> used;
+
+	int cnb = 0;
+	for (int v = 0; v < vnb; ++v)
+	{
+		used.clear();
+		for (auto a = _neighbors[v].begin(); a != _neighbors[v].end(); ++a)
+		{
+			used.push_back(colors[*a]);
+			for (auto b = _neighbors[*a].begin(); b != _neighbors[*a].end(); ++b)
+				used.push_back(colors[*b]);
+		}
+
+		std::sort(used.begin(), used.end());
+
+		int color = 0;
+		for (size_t i = 0; i < used.size(); ++i)
+		{
+			if (used[i] == color)
+				++color;
+			else if (used[i] > color)
+				break;
+		}
+
+		colors[v] = color;
+		cnb = (std::max)(cnb, color + 1);
+	}
+
+	classStart.assign(cnb + 1, 0);
+	for (int v = 0; v < vnb; ++v)
+		++classStart[colors[v] + 1];
+	for (int k = 0; k < cnb; ++k)
+		classStart[k + 1] += classStart[k];
+
+	classSites.resize(vnb);
+	std::vector<int> fill(classStart.begin(), classStart.end() - 1);
+	for (int v = 0; v < vnb; ++v)
+		classSites[fill[colors[v]]++] = v;
+
+	return cnb;
+}
+
+// the domain cut by the bisectors of c and the given sites, site moved at q, flags as in the diagram
+void VoroApprox::clip_cell(int c, int moved, const double *q, const std::vector<int> &sites, LocalWorkspace &ws) const
+{
+	double r = _params.ratio;
+	double rect[8] = { -1, -r, 1, -r, 1, r, -1, r };
+	ws.polygon.assign(rect, rect + 8);
+
+	// border segment bs has flag -bs - 1
+	ws.flags.resize(4);
+	for (int i = 0; i < 4; ++i)
+		ws.flags[i] = -i - 1;
+
+	const double *a = c == moved ? q : &_sites[2 * c];
+	for (size_t k = 0; k < sites.size() && ws.polygon.size() >= 6; ++k)
+	{
+		int u = sites[k];
+		if (u == c)
+			continue;
+
+		const double *b = u == moved ? q : &_sites[2 * u];
+
+		// n . x <= offset on the side of c
+		double nx = b[0] - a[0];
+		double ny = b[1] - a[1];
+		double offset = 0.5 * (nx * (a[0] + b[0]) + ny * (a[1] + b[1]));
+		if (_params.powerDiagram)
+			offset += 0.5 * (_weights[c] - _weights[u]);
+
+		ws.clipped.clear();
+		ws.clippedFlags.clear();
+
+		int n = (int)ws.polygon.size() / 2;
+		for (int i = 0; i < n; ++i)
+		{
+			int j = (i + 1) % n;
+			const double *p0 = &ws.polygon[2 * i];
+			const double *p1 = &ws.polygon[2 * j];
+
+			double d0 = nx * p0[0] + ny * p0[1] - offset;
+			double d1 = nx * p1[0] + ny * p1[1] - offset;
+
+			if (d0 <= 0.0)
+			{
+				ws.clipped.push_back(p0[0]);
+				ws.clipped.push_back(p0[1]);
+				ws.clippedFlags.push_back(ws.flags[i]);
+			}
+
+			if ((d0 < 0.0 && d1 > 0.0) || (d0 > 0.0 && d1 < 0.0))
+			{
+				double t = d0 / (d0 - d1);
+				ws.clipped.push_back(p0[0] + t * (p1[0] - p0[0]));
+				ws.clipped.push_back(p0[1] + t * (p1[1] - p0[1]));
+
+				// leaving the half plane, the next segment runs along the bisector
+				ws.clippedFlags.push_back(d0 < 0.0 ? u : ws.flags[i]);
+			}
+		}
+
+		ws.polygon.swap(ws.clipped);
+		ws.flags.swap(ws.clippedFlags);
+	}
+}
+
+/**
+* only v moves, so a cell changes iff it borders v before or after the move, and its new
+* neighbors are its old ones or changed cells
+* the new neighbors of v are looked for in its 2-ring, the move is refused if a site of the
+* 3-ring would bound the new cell, or if a changed cell vanishes
+* both energies come from the same clipping, rasterization and fit
+*/
+bool VoroApprox::local_move(int v, const double *q, LocalWorkspace &ws, LocalMove &move) const
+{
+	const std::vector<int> &ring1 = _neighbors[v];
+
+	ws.ring.assign(1, v);
+	ws.ring.insert(ws.ring.end(), ring1.begin(), ring1.end());
+	for (auto a = ring1.begin(); a != ring1.end(); ++a)
+		ws.ring.insert(ws.ring.end(), _neighbors[*a].begin(), _neighbors[*a].end());
+
+	std::sort(ws.ring.begin(), ws.ring.end());
+	ws.ring.erase(std::unique(ws.ring.begin(), ws.ring.end()), ws.ring.end());
+
+	ws.outer = ws.ring;
+	for (auto a = ws.ring.begin(); a != ws.ring.end(); ++a)
+		ws.outer.insert(ws.outer.end(), _neighbors[*a].begin(), _neighbors[*a].end());
+
+	std::sort(ws.outer.begin(), ws.outer.end());
+	ws.outer.erase(std::unique(ws.outer.begin(), ws.outer.end()), ws.outer.end());
+
+	clip_cell(v, v, q, ws.outer, ws);
+
+	move.cells.assign(1, v);
+	move.cells.insert(move.cells.end(), ring1.begin(), ring1.end());
+	for (size_t i = 0; i < ws.flags.size(); ++i)
+	{
+		if (ws.flags[i] < 0)
+			continue;
+
+		if (!std::binary_search(ws.ring.begin(), ws.ring.end(), ws.flags[i]))
+			return false;
+
+		move.cells.push_back(ws.flags[i]);
+	}
+
+	std::sort(move.cells.begin(), move.cells.end());
+	move.cells.erase(std::unique(move.cells.begin(), move.cells.end()), move.cells.end());
+
+	move.reads = move.cells;
+	for (auto c = move.cells.begin(); c != move.cells.end(); ++c)
+		move.reads.insert(move.reads.end(), _neighbors[*c].begin(), _neighbors[*c].end());
+
+	std::sort(move.reads.begin(), move.reads.end());
+	move.reads.erase(std::unique(move.reads.begin(), move.reads.end()), move.reads.end());
+
+	int cnb = (int)move.cells.size();
+	move.neighborStart.assign(1, 0);
+	move.neighbors.clear();
+	move.before = 0.0;
+	move.after = 0.0;
+
+	const double *p = &_sites[2 * v];
+	for (int k = 0; k < cnb; ++k)
+	{
+		int c = move.cells[k];
+
+		double before, after;
+		if (!local_energy(c, v, p, move.reads, ws, before) || !local_energy(c, v, q, move.reads, ws, after))
+			return false;
+
+		move.before += before;
+		move.after += after;
+
+		// the clip of the moved state is still in ws
+		size_t start = move.neighbors.size();
+		for (size_t i = 0; i < ws.flags.size(); ++i)
+		{
+			if (ws.flags[i] > -1)
+				move.neighbors.push_back(ws.flags[i]);
+		}
+
+		std::sort(move.neighbors.begin() + start, move.neighbors.end());
+		move.neighbors.erase(std::unique(move.neighbors.begin() + start, move.neighbors.end()), move.neighbors.end());
+		move.neighborStart.push_back((int)move.neighbors.size());
+	}
+
+	return true;
+}
+
+// energy of cell c cut by the given sites, site moved at q, false if the cell vanishes
+bool VoroApprox::local_energy(int c, int moved, const double *q, const std::vector<int> &sites, LocalWorkspace &ws, double &energy) const
+{
+	clip_cell(c, moved, q, sites, ws);
+
+	int n = (int)ws.polygon.size() / 2;
+	if (n < 3)
+		return false;
+
+	int degree = _coefficients.degree(c);
+	MyKernels::FitPlanar fit = MyKernels::fit_planar(degree, _params.channel);
+	MyKernels::EnergyPlanar cellEnergy = MyKernels::energy_planar(degree, _params.channel);
+	if (!fit || !cellEnergy)
+		return false;
+
+	ws.pixels.clear();
+	ws.pixels.resize(1);
+	Rasterizer::rasterize(&ws.polygon[0], n, _params.width, _params.height, ws.pixels, 0);
+
+	PixelSet pixels = ws.pixels[0];
+	double coeff[4 * Legendre::MaxTerms], transform[3];
+	fit(_planar, &pixels, coeff, transform);
+
+	energy = cellEnergy(coeff, transform, _planar, &pixels, _params.Lp);
+	return true;
+}
+
+int VoroApprox::optimize_to_tolerance(int degree, double tolerance, int maxSites, int iteration, double stepScale /* = 0.3*/)
+{
+	if (!_params.image)
+		return 0;
+
+	_params.degree = degree;
+
+	if (_sites.empty())
+		greedy_init((std::min)(maxSites, 16));
+	else
+		compute_voronoi();
+
+	if (!has_diagram())
+		return 0;
+
+	double saved = _params.tolerance;
+	_params.tolerance = tolerance;
+
+	assign_pixels();
+	compute_polynomials();
+	compute_energies();
+
+	for (int round = 0; ; ++round)
+	{
+		int vnb = sites_number();
+
+		std::vector<int> cells;
+		for (int v = 0; v < vnb; ++v)
+		{
+			if (cell_error(v) > tolerance)
+				cells.push_back(v);
+		}
+
+		xlog("round = %d, sites = %d, cells above tolerance = %d", round, vnb, (int)cells.size());
+
+		if (cells.empty() || vnb >= maxSites)
+			break;
+
+		// worst cells first, at most a quarter more sites per round
+		std::sort(cells.begin(), cells.end(), [&](int a, int b)
+		{
+			return cell_error(a) > cell_error(b);
+		});
+
+		int count = (std::min)((int)cells.size(), maxSites - vnb);
+		count = (std::min)(count, (std::max)(1, vnb / 4));
+
+		if (split_cells(cells, count) == 0)
+			break;
+
+		// runs the fits and energies the next round checks
+		optimize(degree, iteration, stepScale);
+	}
+
+	_params.tolerance = saved;
+
+	return sites_number();
+}
+
+/**
+* each level starts from the converged layout of the one before: the cells of highest energy
+* are split at their farthest corners, with a refit between the rounds of splits
+*/
+int VoroApprox::optimize_multilevel(int degree, int vnb, int levels, int iteration, double stepScale /* = 0.3*/)
+{
+	if (!_params.image || vnb < 1)
+		return 0;
+
+	const int factor = 4;
+
+	// vnb / factor^k, the last level is vnb itself
+	std::vector<int> targets(1, vnb);
+	for (int l = 1; l < levels && targets.back() / factor > 0; ++l)
+		targets.push_back(targets.back() / factor);
+	std::reverse(targets.begin(), targets.end());
+
+	int coarse = targets[0];
+
+	// keeps a coarser layout the caller prepared
+	if (_sites.empty() || sites_number() > coarse)
+		importance_init(coarse);
+
+	_params.degree = degree;
+
+	optimize(degree, iteration, stepScale);
+
+	for (size_t l = 1; l < targets.size(); ++l)
+	{
+		int target = targets[l];
+
+		int added = 0;
+		while (sites_number() < target)
+		{
+			int n = sites_number();
+			if ((int)_energies.size() != n)
+				break;
+
+			std::vector<int> cells(n);
+			std::iota(cells.begin(), cells.end(), 0);
+			std::sort(cells.begin(), cells.end(), [&](int a, int b)
+			{
+				return _energies[a] > _energies[b];
+			});
+
+			// a quarter more per round, as optimize_to_tolerance, keeps the splits where the energy is
+			int count = split_cells(cells, (std::min)((std::max)(1, n / 4), target - n));
+			if (count == 0)
+				break;
+			added += count;
+
+			assign_pixels();
+			compute_polynomials();
+			compute_energies();
+		}
+
+		if (added == 0)
+			break;
+
+		xlog("level sites = %d", sites_number());
+
+		optimize(degree, iteration, stepScale);
+	}
+
+	return sites_number();
+}
+
+int VoroApprox::split_cells(const std::vector<int> &cells, int count)
+{
+	int added = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		double p[2];
+		if (farthest_corner(cells[i], p) && add_site(p))
+			++added;
+	}
+
+	if (added > 0)
+		update_diagram();
+
+	return added;
+}
+
+int VoroApprox::reseat_hidden_sites(std::vector<int> &reseated)
+{
+	reseated.clear();
+
+	int vnb = sites_number();
+	if (!_params.powerDiagram || !has_diagram() || cells_number() != vnb || (int)_energies.size() != vnb)
+		return 0;
+
+	std::vector<int> visible;
+	for (int v = 0; v < vnb; ++v)
+	{
+		if (cell(v).faces_number() > 0)
+			visible.push_back(v);
+		else
+			reseated.push_back(v);
+	}
+
+	if (reseated.empty())
+		return 0;
+
+	// the energies are of the cells before the last move, good enough to rank them
+	int count = (std::min)((int)reseated.size(), (int)visible.size());
+	std::partial_sort(visible.begin(), visible.begin() + count, visible.end(),
+		[&](int a, int b) { return _energies[a] > _energies[b]; });
+
+	int moved = 0;
+	for (int k = 0; k < count; ++k)
+	{
+		int v = reseated[k];
+		int w = visible[k];
+
+		double p[2];
+		if (!farthest_corner(w, p))
+			continue;
+
+		// halfway to the corner with the same weight, so the split takes a fair part of the cell
+		_sites[2 * v] = 0.5 * (_sites[2 * w] + p[0]);
+		_sites[2 * v + 1] = 0.5 * (_sites[2 * w + 1] + p[1]);
+		_weights[v] = _weights[w];
+		reseated[moved++] = v;
+	}
+
+	reseated.resize(moved);
+	if (moved > 0)
+		compute_voronoi();
+
+	return moved;
+}
+
+double VoroApprox::cell_error(int v) const
+{
+	double area = _pixels[v].area() * _params.pixArea;
+	if (area <= 0.0)
+		return 0.0;
+
+	return _energies[v] / area / _params.channel;
+}
+
+double VoroApprox::max_cell_error() const
+{
+	double result = 0.0;
+
+	int vnb = (int)_energies.size();
+	for (int v = 0; v < vnb; ++v)
+		result = (std::max)(result, cell_error(v));
+
+	return result;
+}
+
+void VoroApprox::approximate(int degree, unsigned char *output, int width, int height, int channel)
+{
+	if (!_params.image || !has_diagram() || !output || channel > _params.channel)
+		return;
+
+	memset(output, 0, sizeof(unsigned char) * width * height * channel);
+
+	_params.degree = degree;
+
+	int vnb = cells_number();
+
+	// right after an optimize the fits already belong to this diagram
+	bool fitted = _fitVersion == _diagramVersion && _pixelsVersion == _diagramVersion &&
+		_coefficients.cells_number() == vnb && _coefficients.degree() == degree;
+	if (!fitted)
+	{
+		assign_pixels();
+		compute_polynomials();
+	}
+
+	gather_polygons();
+
+	// cells are binned into the output tiles their pixel boxes overlap
+	const int tileSize = 64;
+	int tilesX = (width + tileSize - 1) / tileSize;
+	int tilesY = (height + tileSize - 1) / tileSize;
+	int tnb = tilesX * tilesY;
+
+	double scale = 0.5 * width;
+	std::vector<int> boxes(4 * vnb);
+	std::vector<int> tileStart(tnb + 1, 0);
+
+	for (int v = 0; v < vnb; ++v)
+	{
+		int *box = &boxes[4 * v];
+		box[0] = 0;
+		box[1] = -1;
+		box[2] = 0;
+		box[3] = -1;
+
+		int begin = _polygonOffsets[v], end = _polygonOffsets[v + 1];
+		if (end - begin < 3)
+			continue;
+
+		double xlo = DBL_MAX, xhi = -DBL_MAX, ylo = DBL_MAX, yhi = -DBL_MAX;
+		for (int k = begin; k < end; ++k)
+		{
+			xlo = (std::min)(xlo, _polygons[2 * k]);
+			xhi = (std::max)(xhi, _polygons[2 * k]);
+			ylo = (std::min)(ylo, _polygons[2 * k + 1]);
+			yhi = (std::max)(yhi, _polygons[2 * k + 1]);
+		}
+
+		// pixel centers in the box, one pixel of slack
+		box[0] = (std::max)(0, int(floor((xlo + 1.0) * scale)) - 1) / tileSize;
+		box[1] = (std::min)(width - 1, int(ceil((xhi + 1.0) * scale)) + 1) / tileSize;
+		box[2] = (std::max)(0, int(floor(ylo * scale + 0.5 * height)) - 1) / tileSize;
+		box[3] = (std::min)(height - 1, int(ceil(yhi * scale + 0.5 * height)) + 1) / tileSize;
+
+		for (int ty = box[2]; ty <= box[3]; ++ty)
+		{
+			for (int tx = box[0]; tx <= box[1]; ++tx)
+				++tileStart[ty * tilesX + tx + 1];
+		}
+	}
+
+	for (int t = 0; t < tnb; ++t)
+		tileStart[t + 1] += tileStart[t];
+
+	std::vector<int> tileCells(tileStart[tnb]);
+	std::vector<int> fill(tileStart.begin(), tileStart.end() - 1);
+	for (int v = 0; v < vnb; ++v)
+	{
+		const int *box = &boxes[4 * v];
+		for (int ty = box[2]; ty <= box[3]; ++ty)
+		{
+			for (int tx = box[0]; tx <= box[1]; ++tx)
+				tileCells[fill[ty * tilesX + tx]++] = v;
+		}
+	}
+
+	double ratio = double(height) / width;
+	double pixWidth = double(2.0) / width;
+
+	const SpanKernels &kernels = span_kernels();
+
+	// spans partition the output, every pixel is written once, by the thread of its tile
+#pragma omp parallel
+	{
+		const int chunk = 64;
+		float values[chunk];
+
+		// the rows of one cell inside one tile
+		PixelSets band;
+
+#pragma omp for schedule(dynamic, 1)
+		for (int t = 0; t < tnb; ++t)
+		{
+			int x0 = (t % tilesX) * tileSize;
+			int y0 = (t / tilesX) * tileSize;
+			int x1 = (std::min)(x0 + tileSize, width) - 1;
+			int y1 = (std::min)(y0 + tileSize, height) - 1;
+
+			for (int k = tileStart[t]; k < tileStart[t + 1]; ++k)
+			{
+				int v = tileCells[k];
+				int begin = _polygonOffsets[v];
+
+				band.clear();
+				band.resize(1);
+				Rasterizer::rasterize_rows(&_polygons[2 * begin], _polygonOffsets[v + 1] - begin, width, height, y0, y1, band, 0);
+
+				PixelSet pixels = band[0];
+				for (int j = pixels.ymin; j <= pixels.ymax; ++j)
+				{
+					double y = pixWidth * (j + 0.5) - ratio;
+					int lineStart = j * width;
+
+					int loc = j - pixels.ymin;
+					int left = (std::max)(pixels.left[loc], x0);
+					int right = (std::min)(pixels.right[loc], x1);
+
+					for (int i0 = left; i0 <= right; i0 += chunk)
+					{
+						int n = (std::min)(chunk, right - i0 + 1);
+						double xs = pixWidth * (i0 + 0.5) - 1.0;
+						unsigned char *pixColor = &output[(lineStart + i0) * channel];
+
+						for (int c = 0; c < channel; ++c)
+						{
+							double b[Legendre::MaxDegree + 1];
+							_coefficients.row_coefficients(v, c, y, b);
+							kernels.evaluate(values, n, _coefficients.local_x(v, xs), pixWidth * _coefficients.scale(v), b, _coefficients.degree(v));
+
+							for (int m = 0; m < n; ++m)
+							{
+								float val = values[m];
+								if (val > 255) val = 255;
+								if (val < 0) val = 0;
+
+								pixColor[m * channel + c] = (unsigned char)(val);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void VoroApprox::sites_data(std::vector<float> &sites)
+{
+	sites.clear();
+
+	for (auto it = _sites.begin(); it != _sites.end(); ++it)
+		sites.push_back(float(*it));
+}
+
+void VoroApprox::voronoi_data(std::vector<float> &corners, std::vector<int> &edges)
+{
+	corners.clear();
 	edges.clear();
 
-	if (!_voro)
+	if (!has_diagram())
 		return;
 
 	int start = 0;
-	int vnb = _voro->cells_number();
+	int vnb = cells_number();
 
 	double shrink = 1.0;
 
 	for (int i = 0; i < vnb; ++i)
 	{
-		const MyPolygonCell *cell = _voro->cell(i);
+		MyPolygonCell cell = this->cell(i);
 
-		for (int f = 0; f < cell->faces_number(); ++f)
+		for (int f = 0; f < cell.faces_number(); ++f)
 		{
-			int fsize = cell->face_size(f);
-			for (int v = cell->face_begin(f), j = 0; v < cell->face_end(f); ++v, ++j)
+			int fsize = cell.face_size(f);
+			for (int v = cell.face_begin(f), j = 0; v < cell.face_end(f); ++v, ++j)
 			{
-				const double *p = cell->point(v);
+				const double *p = cell.point(v);
 				corners.push_back(float(p[0] * shrink + _sites[2 * i] * (1.0 - shrink)));
 				corners.push_back(float(p[1] * shrink + _sites[2 * i + 1] * (1.0 - shrink)));
 
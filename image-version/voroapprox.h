@@ -8,9 +8,15 @@
 #define POLYNOMIAL_APPROXIMATION_ON_VORONOI_H
 
 #include "delaunay2.h"
+#include "regular2.h"
 #include "voronoi2.h"
 #include "pixelset.h"
 #include "polynomial.h"
+#include "polynomial_table.h"
+#include "rasterizer.h"
+#include "jumpflood.h"
+#include "planar_image.h"
+#include "span_kernels.h"
 
 using namespace xyy;
 
@@ -28,60 +34,278 @@ class VoroApprox
 
 		int degree = 1;
 
+		// per cell degree in 0 ... degree, one more degree has to remove
+		// degreeCost squared intensity errors, summed over pixels, per added coefficient
+		bool adaptiveDegree = false;
+		double degreeCost = 100.0;
+
+		// every adaptPeriod iterations, up to adaptFraction of the sites move
+		// from the cheapest merges to the highest energy cells
+		bool adaptiveSites = false;
+		int adaptPeriod = 5;
+		double adaptFraction = 0.05;
+
+		// optimize() stops once every cell_error() is below, 0 runs all iterations
+		double tolerance = 0.0;
+
+		// optimize() only rebuilds, refits and rescores the cells whose polygon changed
+		bool dirtyCells = true;
+
+		// a site stays put once a full step would remove less than freezeThreshold
+		// of the mean cell energy for freezeIterations iterations in a row, 0 never freezes
+		double freezeThreshold = 0.0;
+		int freezeIterations = 3;
+
+		// early optimize() iterations fit and score each cell on a stratified sample of its pixels,
+		// the rate climbs from minSampleRate to 1 over the first half of the run, 1 samples all
+		double minSampleRate = 1.0;
+
 		int Lp = 2;
+
+		bool labelGradient = false;
+		bool discreteVoronoi = false;
+
+		// weighted sites, power cells from the regular triangulation
+		// the jump flood is euclidean, so this overrides discreteVoronoi
+		bool powerDiagram = false;
 	};
 
-	typedef PolygonCell<double, int> MyPolygonCell;
+	typedef PolygonCells<double, int>::Cell MyPolygonCell;
 	typedef Voronoi2D<DelaunayTriangulation2D> MyVoronoi;
+	typedef Voronoi2D<RegularTriangulation2D> MyPowerDiagram;
 	typedef Polynomial<double> MyPolynomial;
+	typedef PolynomialTable<double> MyPolynomialTable;
+	typedef PolynomialKernels<double> MyKernels;
+
+	// scratch of the local energy oracle, one per thread
+	struct LocalWorkspace
+	{
+		std::vector<int>    ring;
+		std::vector<int>    outer;
+		std::vector<double> polygon;
+		std::vector<double> clipped;
+		std::vector<int>    flags;
+		std::vector<int>    clippedFlags;
+		PixelSets           pixels;
+	};
+
+	/**
+	* a trial move of one site: the cells it changes, the sites their polygons depend on,
+	* their energies before and after, and their neighbors after (cell k owns neighbors[neighborStart[k]] ... )
+	*/
+	struct LocalMove
+	{
+		bool                accepted;
+		double              q[2];
+		double              before;
+		double              after;
+		std::vector<int>    cells;
+		std::vector<int>    reads;
+		std::vector<int>    neighborStart;
+		std::vector<int>    neighbors;
+	};
+
+	// boundary samples of the gradient, evaluated in one batch
+	struct GradientSamples
+	{
+		std::vector<int>    cellA;
+		std::vector<int>    cellB;
+		std::vector<int>    pixA;
+		std::vector<int>    pixB;
+		std::vector<double> x;
+		std::vector<double> y;
+		std::vector<double> weight;
+
+		std::vector<double> energyA;
+		std::vector<double> energyB;
+		std::vector<double> values;
+
+		// keeps capacity
+		void clear()
+		{
+			cellA.clear();
+			cellB.clear();
+			pixA.clear();
+			pixB.clear();
+			x.clear();
+			y.clear();
+			weight.clear();
+		}
+
+		int size() const
+		{
+			return (int)cellA.size();
+		}
+
+		void add(int a, int b, int pa, int pb, const double *p, double w)
+		{
+			cellA.push_back(a);
+			cellB.push_back(b);
+			pixA.push_back(pa);
+			pixB.push_back(pb);
+			x.push_back(p[0]);
+			y.push_back(p[1]);
+			weight.push_back(w);
+		}
+	};
 
 protected:
 	Parameters                _params;
+	PlanarImage               _planar;
 	std::vector<double>       _sites;
 	DelaunayTriangulation2D  *_dt;
 	MyVoronoi                *_voro;
 
-	std::vector<PixelSet>     _pixels;
-	std::vector<MyPolynomial> _polynomials;
+	// power diagram mode
+	std::vector<double>       _weights;
+	RegularTriangulation2D   *_rt;
+	MyPowerDiagram           *_power;
+
+	PixelSets                 _pixels;
+	MyPolynomialTable         _coefficients;
 	std::vector<double>       _energies;
 
+	std::vector<int>          _labels;
+
+	std::vector<double>       _polygons;
+	std::vector<int>          _polygonOffsets;
+
+	// the polygons behind _pixels, and the cells rebuilt since, empty if all are
+	std::vector<double>       _rasterPolygons;
+	std::vector<int>          _rasterOffsets;
+	std::vector<char>         _dirty;
+
+	// pixel stride of compute_polynomials / compute_energies, of the current fits,
+	// and the round that seeds the sample offsets
+	int                       _sampleStep;
+	int                       _fitStep;
+	int                       _sampleRound;
+
+	// sorted neighbors of each cell, kept up to date by the local moves
+	std::vector<std::vector<int>> _neighbors;
+	std::vector<LocalWorkspace>   _localWorkspaces;
+
+	// the diagram changes its version on every rebuild, the pixels and fits
+	// keep the version they were built from, -1 if none
+	int                       _diagramVersion;
+	int                       _pixelsVersion;
+	int                       _fitVersion;
+
+	// scratch buffers reused across iterations
+	Rasterizer::Workspace     _rasterWorkspace;
+	JumpFlood::Workspace      _floodWorkspace;
+	GradientSamples           _samples;
+
 public:
 	VoroApprox();
 	~VoroApprox();
 
 	void set_degree(int d) { _params.degree = d; }
+	void set_adaptive_degree(bool on) { _params.adaptiveDegree = on; _fitVersion = -1; }
+	void set_degree_cost(double cost) { _params.degreeCost = cost; _fitVersion = -1; }
+	void set_adaptive_sites(bool on) { _params.adaptiveSites = on; }
+	void set_label_gradient(bool on) { _params.labelGradient = on; }
+	void set_discrete_voronoi(bool on) { _params.discreteVoronoi = on; }
+	void set_dirty_cells(bool on) { _params.dirtyCells = on; }
+	void set_freezing(double threshold, int iterations) { _params.freezeThreshold = threshold; _params.freezeIterations = iterations; }
+	void set_sampling(double minRate) { _params.minSampleRate = minRate; }
+	void set_power_diagram(bool on);
 
 	void set_image(const unsigned char *image, int width, int height, int channel);
 
 	void random_init(int vnb);
 	void greedy_init(int vnb);
+	void cvt_init(int vnb, int iteration = 10);
+	void importance_init(int vnb, bool blueNoise = true);
+	void slic_init(int vnb, int iteration = 10, double compactness = 10.0);
 	void set_sites(const double *sites, int n);
 
 	void compute_voronoi();
 	void assign_pixels();
+	int assign_dirty_pixels();
 	void compute_polynomials();
 	double compute_energies();
-	void compute_gradients(double *g, int n);
+	void compute_gradients(double *g, int n, double *gw = NULL);
+	int adapt_sites();
 
 	void optimize(int degree, int iteration, double stepScale = 0.3);
 
+	// Gauss-Seidel sweeps: sites of one color class try a gradient step in parallel,
+	// a move is kept only if the energy of the cells it changes drops, a sweep only if the total does
+	void optimize_local(int degree, int iteration, double stepScale = 0.3);
+
+	// adds sites and optimizes in rounds of iteration steps until every cell is within
+	// tolerance or maxSites is reached, returns the sites number
+	int optimize_to_tolerance(int degree, double tolerance, int maxSites, int iteration, double stepScale = 0.3);
+
+	// optimizes vnb / 4^(levels - 1) sites, then 4 times more per level until vnb,
+	// iteration per level, returns the sites number
+	int optimize_multilevel(int degree, int vnb, int levels, int iteration, double stepScale = 0.3);
+
+	// mean squared error of cell v per pixel and channel
+	double cell_error(int v) const;
+
+	// reuses the fits while they match the diagram, output tiles are rendered in parallel
 	void approximate(int degree, unsigned char *output, int width, int height, int channel);
 
 	// data access
+	int sites_number() const { return (int)_sites.size() / 2; }
 	std::vector<double>& sites() { return _sites; }
+	std::vector<double>& weights() { return _weights; }
 	void sites_data(std::vector<float> &sites);
 	void voronoi_data(std::vector<float> &corners, std::vector<int> &edges);
 
 protected:
-	void compute_gradient(
-		const double *A,
-		const MyPolynomial *polynomialA,
-		const double *B,
-		const MyPolynomial *polynomialB,
+	void sample_edge(
+		int a,
+		int b,
 		const double *source,
-		const double *target,
-		double *result) const;
+		const double *target);
+	void compute_label_gradients(double *g, int n, double *gw);
+	void sample_label_pair(
+		int a,
+		int b,
+		int pixA,
+		int pixB,
+		const double *p,
+		bool horizontal);
+	void evaluate_samples();
 	void locate_point(const double *p, int &i, int &j) const;
+	bool farthest_corner(int v, double *p) const;
+
+	// sites at the farthest corners of the first count cells, updates the diagram, returns the number added
+	int split_cells(const std::vector<int> &cells, int count);
+
+	// moves power sites without a cell to the farthest corners of the highest energy cells,
+	// updates the diagram, returns the moved sites in reseated
+	int reseat_hidden_sites(std::vector<int> &reseated);
+
+	// the diagram of the current mode
+	bool has_diagram() const { return _params.powerDiagram ? _power != NULL : _voro != NULL; }
+	int cells_number() const { return _params.powerDiagram ? _power->cells_number() : _voro->cells_number(); }
+	MyPolygonCell cell(int v) const { return _params.powerDiagram ? _power->cell(v) : _voro->cell(v); }
+	bool discrete() const { return _params.discreteVoronoi && !_params.powerDiagram; }
+
+	// keep the triangulation, sites, weights and coefficients in step, update_diagram rebuilds the cells
+	bool add_site(const double *p);
+	void remove_site(int v);
+	void update_diagram();
+	double max_cell_error() const;
+	void compute_steps(std::vector<double> &steps, double stepScale) const;
+	void gather_polygons();
+
+	// local oracle of optimize_local
+	void build_neighbors();
+	int color_sites(std::vector<int> &classStart, std::vector<int> &classSites) const;
+	void clip_cell(int c, int moved, const double *q, const std::vector<int> &sites, LocalWorkspace &ws) const;
+	bool local_move(int v, const double *q, LocalWorkspace &ws, LocalMove &move) const;
+	bool local_energy(int c, int moved, const double *q, const std::vector<int> &sites, LocalWorkspace &ws, double &energy) const;
+
+	bool clean(int v) const { return !_dirty.empty() && !_dirty[v]; }
+
+	// subsampling of optimize()
+	int sample_step(int it, int iteration) const;
+	PixelSample cell_sample(int v, int salt) const;
 };
 
 #endif
@@ -35,11 +35,27 @@ bool DelaunayTriangulation2D::set_vertices(const double *pos, int vnb)
 DelaunayTriangulation2D::Vertex_handle DelaunayTriangulation2D::add_vertex(const double *p)
 {
 	Vertex_handle vh = insert(Point(p[0], p[1]));
-	if (vh != 0)
+
+	// a duplicate point returns the vertex already there
+	if (vh != 0 && vh->index() < 0)
 	{
 		vh->set_index((int)_vertices.size());
 		_vertices.push_back(vh);
 	}
 
 	return vh;
+}
+
+void DelaunayTriangulation2D::remove_vertex(int i)
+{
+	remove(_vertices[i]);
+
+	int last = (int)_vertices.size() - 1;
+	if (i != last)
+	{
+		_vertices[i] = _vertices[last];
+		_vertices[i]->set_index(i);
+	}
+
+	_vertices.pop_back();
 }
\ No newline at end of file
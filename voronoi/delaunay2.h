@@ -19,7 +19,8 @@ class My_Delaunay_Triangulation_Vertex2D : public Vbb
 {
 public:
 	typedef typename K::FT FT;
-	typedef typename K::Point_2     Point;
+	// weighted for the regular triangulation
+	typedef typename Vbb::Point     Point;
 	typedef typename K::Vector_2    Vector;
 	typedef typename K::Segment_2   Segment;
 
@@ -154,6 +155,8 @@ public:
 
 	bool set_vertices(const double *pos, int vnb);
 	Vertex_handle add_vertex(const double *p);
+	// the last vertex takes over index i
+	void remove_vertex(int i);
 
 	template <typename Real, typename Flag>
 	void compute_dual(int v, std::vector<DualSegment<Real, Flag>*> &segments) const;
@@ -8,6 +8,7 @@
 #define POLYGON_CELL_H
 
 #include <vector>
+#include "utility.h"
 
 namespace xyy
 {
@@ -162,29 +163,13 @@ namespace xyy
 
 		Real face_area(int f) const
 		{
-			Real area = Real(0.0);
-
-			int s = face_begin(f);
-			const Real *p0 = point(s);
-
-			int nexts = next_around_face(f, s);
-			int nextnexts = next_around_face(f, nexts);
-
-			const Real *p1 = point(nexts);
-			Real a[2] = { p1[0] - p0[0], p1[1] - p0[1] };
-
-			for (int i = nextnexts; i != s; i = next_around_face(f, i))
-			{
-				const Real *p2 = point(i);
-				Real b[2] = { p2[0] - p0[0], p2[1] - p0[1] };
-
-				area += Real(0.5) * (a[0] * b[1] - b[0] * a[1]);
-
-				a[0] = b[0];
-				a[1] = b[1];
-			}
+			return polygon_area2d(point(face_begin(f)), face_size(f));
+		}
 
-			return area;
+		// area weighted center, returns the area
+		Real face_centroid(int f, Real *cent) const
+		{
+			return polygon_centroid2d(point(face_begin(f)), face_size(f), cent);
 		}
 	};
 }
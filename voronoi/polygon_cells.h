@@ -0,0 +1,264 @@
+
+/**
+* author: Yanyang Xiao
+* email : yanyangxiaoxyy@gmail.com
+*/
+
+#ifndef POLYGON_CELLS_H
+#define POLYGON_CELLS_H
+
+#include <cstddef>
+#include <vector>
+#include <assert.h>
+#include "utility.h"
+
+namespace xyy
+{
+	/**
+	* flat storage of all cells of a diagram
+	* cell v owns faces [_cellBegin[v], _cellEnd[v]), face f owns points [_faces[f], _faces[f + 1])
+	* a rebuilt cell is appended at the end, the stale range is reclaimed by compact()
+	*/
+	template <typename Real = double, typename Flag = int>
+	class PolygonCells
+	{
+	public:
+		/**
+		* read-only view of one cell, same interface as PolygonCell
+		* point indices are global, invalidated by any change of the storage
+		*/
+		class Cell
+		{
+		private:
+			const PolygonCells *_cells;
+			int                 _fbegin;
+			int                 _fend;
+
+		public:
+			Cell()
+				: _cells(NULL), _fbegin(0), _fend(0)
+			{ }
+
+			Cell(const PolygonCells *cells, int fbegin, int fend)
+				: _cells(cells), _fbegin(fbegin), _fend(fend)
+			{ }
+
+			int faces_number() const
+			{
+				return _fend - _fbegin;
+			}
+
+			int points_number() const
+			{
+				return _fend > _fbegin ? _cells->_faces[_fend] - _cells->_faces[_fbegin] : 0;
+			}
+
+			int face_begin(int f) const
+			{
+				return _cells->_faces[_fbegin + f];
+			}
+
+			int face_end(int f) const
+			{
+				return _cells->_faces[_fbegin + f + 1];
+			}
+
+			int face_size(int f) const
+			{
+				return face_end(f) - face_begin(f);
+			}
+
+			const Real* point(int i) const
+			{
+				return &_cells->_points[2 * i];
+			}
+
+			Flag point_flag(int i) const
+			{
+				return _cells->_flags[i];
+			}
+
+			int next_around_face(int f, int i) const
+			{
+				return (i + 1 == face_end(f) ? face_begin(f) : i + 1);
+			}
+
+			int prev_around_face(int f, int i) const
+			{
+				return (i == face_begin(f) ? face_end(f) - 1 : i - 1);
+			}
+
+			void face_polygon(int f, std::vector<Real> &polygon) const
+			{
+				polygon.assign(
+					_cells->_points.begin() + 2 * face_begin(f),
+					_cells->_points.begin() + 2 * face_end(f));
+			}
+
+			void face_center(int f, Real *cent) const
+			{
+				int vnb = face_size(f);
+
+				assert(vnb > 2);
+
+				cent[0] = Real(0.0);
+				cent[1] = Real(0.0);
+
+				for (int i = face_begin(f); i < face_end(f); ++i)
+				{
+					cent[0] += point(i)[0];
+					cent[1] += point(i)[1];
+				}
+
+				cent[0] /= vnb;
+				cent[1] /= vnb;
+			}
+
+			Real face_area(int f) const
+			{
+				return polygon_area2d(point(face_begin(f)), face_size(f));
+			}
+
+			// area weighted center, returns the area
+			Real face_centroid(int f, Real *cent) const
+			{
+				return polygon_centroid2d(point(face_begin(f)), face_size(f), cent);
+			}
+		};
+
+	private:
+		std::vector<int>    _cellBegin;
+		std::vector<int>    _cellEnd;
+		std::vector<int>    _faces;
+		std::vector<Real>   _points;
+		std::vector<Flag>   _flags;
+		int                 _garbage;
+
+		// compact() builds into these and swaps, so capacity survives
+		std::vector<int>    _tempFaces;
+		std::vector<Real>   _tempPoints;
+		std::vector<Flag>   _tempFlags;
+
+	public:
+		PolygonCells()
+			: _garbage(0)
+		{
+			_faces.push_back(0);
+		}
+
+		// keeps capacity
+		void clear()
+		{
+			_cellBegin.clear();
+			_cellEnd.clear();
+			_faces.clear();
+			_points.clear();
+			_flags.clear();
+			_garbage = 0;
+
+			_faces.push_back(0);
+		}
+
+		int cells_number() const
+		{
+			return (int)_cellBegin.size();
+		}
+
+		// new cells are empty
+		void resize(int n)
+		{
+			int fnb = faces_number();
+			_cellBegin.resize(n, fnb);
+			_cellEnd.resize(n, fnb);
+		}
+
+		int add_cell()
+		{
+			resize(cells_number() + 1);
+			return cells_number() - 1;
+		}
+
+		int faces_number() const
+		{
+			return (int)_faces.size() - 1;
+		}
+
+		int points_number() const
+		{
+			return (int)_flags.size();
+		}
+
+		// points no longer referenced by any cell
+		int garbage() const
+		{
+			return _garbage;
+		}
+
+		Cell cell(int v) const
+		{
+			return Cell(this, _cellBegin[v], _cellEnd[v]);
+		}
+
+		// (re)build cell v: begin_cell, { begin_face, add_point..., end_face }..., end_cell
+		void begin_cell(int v)
+		{
+			_garbage += cell(v).points_number();
+
+			_cellBegin[v] = faces_number();
+			_cellEnd[v] = faces_number();
+		}
+
+		void begin_face()
+		{ }
+
+		void add_point(const Real *p, Flag flag)
+		{
+			_points.push_back(p[0]);
+			_points.push_back(p[1]);
+			_flags.push_back(flag);
+		}
+
+		void end_face()
+		{
+			_faces.push_back(points_number());
+		}
+
+		void end_cell(int v)
+		{
+			_cellEnd[v] = faces_number();
+		}
+
+		// drop the stale ranges left by rebuilt cells, cells are laid out in index order
+		void compact()
+		{
+			_tempFaces.clear();
+			_tempPoints.clear();
+			_tempFlags.clear();
+
+			_tempFaces.push_back(0);
+
+			int cnb = cells_number();
+			for (int v = 0; v < cnb; ++v)
+			{
+				int fbegin = (int)_tempFaces.size() - 1;
+
+				for (int f = _cellBegin[v]; f < _cellEnd[v]; ++f)
+				{
+					_tempPoints.insert(_tempPoints.end(), _points.begin() + 2 * _faces[f], _points.begin() + 2 * _faces[f + 1]);
+					_tempFlags.insert(_tempFlags.end(), _flags.begin() + _faces[f], _flags.begin() + _faces[f + 1]);
+					_tempFaces.push_back((int)_tempFlags.size());
+				}
+
+				_cellBegin[v] = fbegin;
+				_cellEnd[v] = (int)_tempFaces.size() - 1;
+			}
+
+			_faces.swap(_tempFaces);
+			_points.swap(_tempPoints);
+			_flags.swap(_tempFlags);
+			_garbage = 0;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "regular2.h"
+
+bool RegularTriangulation2D::set_vertices(const double *pos, const double *weights, int vnb)
+{
+	clear();
+	_vertices.clear();
+	_vertices.reserve(vnb);
+
+	bool ok = true;
+
+	int index = 0;
+	Vertex_handle vh = 0;
+	Face_handle fh = 0;
+	for (int i = 0; i < vnb; ++i)
+	{
+		vh = insert(Weighted_point(Point(pos[2 * i], pos[2 * i + 1]), weights[i]), fh);
+		if (vh == 0)
+		{
+			ok = false;
+			continue;
+		}
+
+		if (!vh->is_hidden())
+			fh = vh->face();
+
+		vh->set_index(index);
+		_vertices.push_back(vh);
+
+		++index;
+	}
+
+	return ok;
+}
+
+RegularTriangulation2D::Vertex_handle RegularTriangulation2D::add_vertex(const double *p, double weight)
+{
+	Weighted_point wp(Point(p[0], p[1]), weight);
+
+	// insert never merges weighted points, the new vertex would hide the old one or be hidden,
+	// so a point already there, visible or hidden, returns the old vertex as DelaunayTriangulation2D
+	Locate_type lt;
+	int li;
+	Face_handle fh = locate(wp, lt, li);
+	if (lt == thisclass::VERTEX)
+		return fh->vertex(li);
+
+	Vertex_handle same = hidden_vertex(fh, wp);
+	if (same == 0 && lt == thisclass::EDGE)
+		same = hidden_vertex(fh->neighbor(li), wp);
+	if (same != 0)
+		return same;
+
+	Vertex_handle vh = insert(wp, fh);
+	if (vh != 0 && vh->index() < 0)
+	{
+		vh->set_index((int)_vertices.size());
+		_vertices.push_back(vh);
+	}
+
+	return vh;
+}
+
+// hidden vertices sit in the face containing them
+RegularTriangulation2D::Vertex_handle RegularTriangulation2D::hidden_vertex(Face_handle fh, const Weighted_point &wp) const
+{
+	if (fh == 0)
+		return 0;
+
+	for (auto it = fh->vertex_list().begin(); it != fh->vertex_list().end(); ++it)
+	{
+		if ((*it)->point().point() == wp.point())
+			return *it;
+	}
+
+	return 0;
+}
+
+void RegularTriangulation2D::remove_vertex(int i)
+{
+	remove(_vertices[i]);
+
+	int last = (int)_vertices.size() - 1;
+	if (i != last)
+	{
+		_vertices[i] = _vertices[last];
+		_vertices[i]->set_index(i);
+	}
+
+	_vertices.pop_back();
+}
\ No newline at end of file
@@ -0,0 +1,229 @@
+
+#ifndef REGULAR_TRIANGULATION_2D_H
+#define REGULAR_TRIANGULATION_2D_H
+
+#include <vector>
+#include <CGAL/Regular_triangulation_2.h>
+#include <CGAL/Regular_triangulation_vertex_base_2.h>
+#include <CGAL/Regular_triangulation_face_base_2.h>
+
+#include "delaunay2.h"
+
+// Vertex
+typedef CGAL::Regular_triangulation_vertex_base_2<Kernel>                                      CGAL_Regular_Triangulation_Vertex_Base_2;
+typedef My_Delaunay_Triangulation_Vertex2D<Kernel, CGAL_Regular_Triangulation_Vertex_Base_2>   Regular_Triangulation_Vertex2D;
+
+// Face, keeps the hidden vertices
+typedef CGAL::Regular_triangulation_face_base_2<Kernel>                                        Regular_Triangulation_Face2D;
+
+// Triangulation
+typedef CGAL::Triangulation_data_structure_2<Regular_Triangulation_Vertex2D, Regular_Triangulation_Face2D> Regular_Triangulation_Data_Structure_2;
+typedef CGAL::Regular_triangulation_2<Kernel, Regular_Triangulation_Data_Structure_2>          CGAL_Regular_Triangulation2D;
+
+/**
+* weighted Delaunay triangulation, dual of the power diagram
+* same interface as DelaunayTriangulation2D, so Voronoi2D clips power cells the same way
+* a vertex hidden by heavier neighbors keeps its index and has an empty cell
+*/
+class RegularTriangulation2D : public CGAL_Regular_Triangulation2D
+{
+private:
+	typedef CGAL_Regular_Triangulation2D       superclass;
+	typedef RegularTriangulation2D             thisclass;
+
+public:
+	typedef typename thisclass::Geom_traits    Kernel;
+	typedef typename Kernel::Point_2           Point;
+	typedef typename Kernel::Weighted_point_2  Weighted_point;
+	typedef typename Kernel::Vector_2          Vector;
+	typedef typename Kernel::Ray_2             Ray;
+
+	typedef typename thisclass::Vertex_handle            Vertex_handle;
+	typedef typename thisclass::Vertex_circulator        Vertex_circulator;
+
+	typedef typename thisclass::Edge                  Edge;
+	typedef typename thisclass::Edge_circulator       Edge_circulator;
+
+	typedef typename thisclass::Face_handle           Face_handle;
+	typedef typename thisclass::Locate_type           Locate_type;
+
+protected:
+	std::vector<Vertex_handle> _vertices;
+
+	Vertex_handle hidden_vertex(Face_handle fh, const Weighted_point &wp) const;
+
+public:
+	int vertices_number() const
+	{
+		return (int)_vertices.size();
+	}
+
+	Vertex_handle vertex_handle(int i) const
+	{
+		return _vertices[i];
+	}
+
+	Vertex_handle source_vertex(const Edge &e) const
+	{
+		return e.first->vertex(thisclass::ccw(e.second));
+	}
+
+	Vertex_handle target_vertex(const Edge &e) const
+	{
+		return e.first->vertex(thisclass::cw(e.second));
+	}
+
+	// smallest power distance
+	int nearest_vertex_index(const double *query) const
+	{
+		return nearest_power_vertex(Point(query[0], query[1]))->index();
+	}
+
+	bool set_vertices(const double *pos, const double *weights, int vnb);
+	// a point already in the triangulation returns its vertex
+	Vertex_handle add_vertex(const double *p, double weight);
+
+	// the last vertex takes over index i
+	void remove_vertex(int i);
+
+	template <typename Real, typename Flag>
+	void compute_dual(int v, std::vector<DualSegment<Real, Flag>*> &segments) const;
+
+	template <typename Real, typename Flag>
+	void compute_dual(int v, PolygonCell<Real, Flag> &cell) const;
+};
+
+template <typename Real, typename Flag>
+void RegularTriangulation2D::compute_dual(int v, std::vector<DualSegment<Real, Flag>*> &segments) const
+{
+	segments.clear();
+
+	if (_vertices[v]->is_hidden())
+		return;
+
+	const Point pt = _vertices[v]->point().point();
+
+	int start = -1, end = -1;
+
+	Edge_circulator ecirc = incident_edges(_vertices[v]);
+	Edge_circulator eend = ecirc;
+	CGAL_For_all(ecirc, eend)
+	{
+		if (is_infinite(ecirc))
+			continue;
+
+		Edge e(*ecirc);
+		Vertex_handle nhv = source_vertex(e);
+		Point src, tgt;
+
+		Face_handle leftFace = e.first;
+		Face_handle rightFace = leftFace->neighbor(e.second);
+		bool leftInfinite = is_infinite(leftFace);
+		bool rightInfinite = is_infinite(rightFace);
+		// can not be both infinite, the radical axis is orthogonal to the edge
+		if (leftInfinite)
+		{
+			start = (int)segments.size();
+
+			tgt = dual(rightFace);
+
+			const Point ps = nhv->point().point();
+			Vector st90(ps.y() - pt.y(), pt.x() - ps.x());
+			Ray r(tgt, st90);
+
+			src = r.point(TRIANGULATION_2D_INFINITE_DOUBLE);
+		}
+		else if (rightInfinite)
+		{
+			end = (int)segments.size();
+
+			src = dual(leftFace);
+
+			const Point ps = nhv->point().point();
+			Vector st90(pt.y() - ps.y(), ps.x() - pt.x());
+			Ray r(src, st90);
+			tgt = r.point(TRIANGULATION_2D_INFINITE_DOUBLE);
+		}
+		else
+		{
+			src = dual(leftFace);
+			tgt = dual(rightFace);
+		}
+
+		DualSegment<Real, Flag> *obj = new DualSegment<Real, Flag>(&src.x(), &tgt.x(), (Flag)nhv->index());
+		segments.push_back(obj);
+	}
+
+	int snb = (int)segments.size();
+	for (int i = 0; i < snb; ++i)
+	{
+		int j = (i + 1) % snb;
+		int k = (i - 1 + snb) % snb;
+
+		if (i != end)
+			segments[i]->set_next_segment(segments[j]);
+		if (i != start)
+			segments[i]->set_prev_segment(segments[k]);
+	}
+}
+
+template <typename Real, typename Flag>
+void RegularTriangulation2D::compute_dual(int v, PolygonCell<Real, Flag> &cell) const
+{
+	cell.clear();
+
+	if (_vertices[v]->is_hidden())
+		return;
+
+	const Point pt = _vertices[v]->point().point();
+
+	cell.begin_face();
+
+	Edge_circulator ecirc = incident_edges(_vertices[v]);
+	Edge_circulator eend = ecirc;
+	CGAL_For_all(ecirc, eend)
+	{
+		if (is_infinite(ecirc))
+			continue;
+
+		Edge e(*ecirc);
+		Vertex_handle nhv = source_vertex(e);
+
+		Face_handle leftFace = e.first;
+		Face_handle rightFace = leftFace->neighbor(e.second);
+		bool leftInfinite = is_infinite(leftFace);
+		bool rightInfinite = is_infinite(rightFace);
+		// can not be both infinite
+		if (leftInfinite)
+		{
+			Point rcw(dual(rightFace));
+			const Point ps = nhv->point().point();
+
+			Vector st90(ps.y() - pt.y(), pt.x() - ps.x());
+			Ray r(rcw, st90);
+			Point rp(r.point(TRIANGULATION_2D_INFINITE_DOUBLE));
+			cell.add_point(&rp.x(), nhv->index());
+		}
+		else if (rightInfinite)
+		{
+			Point lcw(dual(leftFace));
+			const Point ps = nhv->point().point();
+
+			Vector st90(pt.y() - ps.y(), ps.x() - pt.x());
+			Ray r(lcw, st90);
+			Point rp(r.point(TRIANGULATION_2D_INFINITE_DOUBLE));
+
+			cell.add_point(&lcw.x(), nhv->index());
+			cell.add_point(&rp.x(), -TRIANGULATION_2D_INFINITE_INT);
+		}
+		else
+		{
+			Point lcw(dual(leftFace));
+			cell.add_point(&lcw.x(), nhv->index());
+		}
+	}
+
+	cell.end_face();
+}
+
+#endif
@@ -83,6 +83,60 @@ namespace xyy
 		return fabs(signed_area(a, b, c));
 	}
 
+	// shoelace area of the polygon points[0 .. n - 1], fanned from the first point
+	template <typename Real>
+	Real polygon_area2d(const Real *points, int n)
+	{
+		Real area = Real(0.0);
+
+		const Real *p0 = &points[0];
+		for (int i = 2; i < n; ++i)
+			area += signed_area(p0, &points[2 * i - 2], &points[2 * i]);
+
+		return area;
+	}
+
+	// area weighted center, returns the area, a degenerate polygon gets its vertex average
+	template <typename Real>
+	Real polygon_centroid2d(const Real *points, int n, Real *cent)
+	{
+		Real area = Real(0.0);
+		cent[0] = Real(0.0);
+		cent[1] = Real(0.0);
+
+		const Real *p0 = &points[0];
+		for (int i = 2; i < n; ++i)
+		{
+			const Real *p1 = &points[2 * i - 2];
+			const Real *p2 = &points[2 * i];
+
+			Real t = signed_area(p0, p1, p2);
+			area += t;
+			cent[0] += t * (p1[0] + p2[0] - Real(2.0) * p0[0]);
+			cent[1] += t * (p1[1] + p2[1] - Real(2.0) * p0[1]);
+		}
+
+		if (area <= Real(0.0))
+		{
+			cent[0] = Real(0.0);
+			cent[1] = Real(0.0);
+			for (int i = 0; i < n; ++i)
+			{
+				cent[0] += points[2 * i];
+				cent[1] += points[2 * i + 1];
+			}
+
+			cent[0] /= n;
+			cent[1] /= n;
+			return area;
+		}
+
+		cent[0] = p0[0] + cent[0] / (Real(3.0) * area);
+		cent[1] = p0[1] + cent[1] / (Real(3.0) * area);
+
+		return area;
+	}
+
 	template <typename Real>
 	Real side(Real ax, Real ay, Real bx, Real by, Real px, Real py)
 	{
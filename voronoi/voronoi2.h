@@ -12,6 +12,7 @@
 #include <unordered_map>
 #include "dual_segment.h"
 #include "polygon_cell.h"
+#include "polygon_cells.h"
 #include "utility.h"
 
 namespace xyy
@@ -21,6 +22,7 @@ namespace xyy
 	{
 		typedef DualSegment<Real, int> DualSeg;
 		typedef PolygonCell<Real, int> PolyCell;
+		typedef PolygonCells<Real, int> PolyCells;
 
 		struct StackItem
 		{
@@ -48,7 +50,8 @@ namespace xyy
 
 	protected:
 		PolyCell                              _domain;
-		std::vector<PolyCell>                 _cells;
+		PolyCells                             _cells;
+		PolyCell                              _dualCell;
 
 		std::stack<StackItem>                 _stack;
 		std::vector<bool>                     _marks;
@@ -66,9 +69,9 @@ namespace xyy
 		void compute(const Delaunay *dt);
 		void compute(const Delaunay *dt, int v);
 
-		int cells_number() const { return (int)_cells.size(); }
-		std::vector<PolyCell>& cells() { return _cells; }
-		const PolyCell* cell(int v) const { return &_cells[v]; }
+		int cells_number() const { return _cells.cells_number(); }
+		PolyCells& cells() { return _cells; }
+		typename PolyCells::Cell cell(int v) const { return _cells.cell(v); }
 
 	protected:
 		// stack
@@ -78,6 +81,10 @@ namespace xyy
 
 		void clip(int v, int bf, int bs);
 		void fill_cell(const Delaunay *dt, int v);
+		void end_cell(int v);
+
+		// even-odd over the domain faces, points on the border count as inside
+		bool inside_domain(const Real *p) const;
 
 		void clip(int bf, int bs, std::vector<DualSeg*> &duals, std::vector<DualSeg*> &borders);
 	};
@@ -363,7 +370,7 @@ namespace xyy
 	template <typename Delaunay, typename Real>
 	void Voronoi2D<Delaunay, Real>::fill_cell(const Delaunay *dt, int v)
 	{
-		_cells[v].clear();
+		_cells.begin_cell(v);
 
 		if (!_borders[v].empty())
 		{
@@ -379,12 +386,12 @@ namespace xyy
 					if (in[s])
 						continue;
 
-					_cells[v].begin_face();
+					_cells.begin_face();
 
 					DualSeg *temp = s;
 					do
 					{
-						_cells[v].add_point(temp->source(), temp->flag());
+						_cells.add_point(temp->source(), temp->flag());
 						in[temp] = true;
 
 						DualSeg *next = temp->next_segment();
@@ -399,10 +406,12 @@ namespace xyy
 
 					} while (temp != s);
 
-					_cells[v].end_face();
+					_cells.end_face();
 				}
 			}
 
+			_cells.end_cell(v);
+
 			int nb = (int)_duals[v].size();
 			for (int i = 0; i < nb; ++i)
 			{
@@ -420,24 +429,50 @@ namespace xyy
 			return;
 		}
 
+		// a cell the border flood never reached lies entirely inside or, for a power cell,
+		// entirely outside the domain, an outside one is left empty
 		if (!_duals[v].empty())
 		{
-			_cells[v].begin_face();
-
 			int nb = (int)_duals[v].size();
+
+			bool inside = false;
+			for (int i = 0; i < nb && !inside; ++i)
+				inside = inside_domain(_duals[v][i]->source());
+
+			if (inside)
+				_cells.begin_face();
+
 			for (int i = 0; i < nb; ++i)
 			{
-				_cells[v].add_point(_duals[v][i]->source(), _duals[v][i]->flag());
+				if (inside)
+					_cells.add_point(_duals[v][i]->source(), _duals[v][i]->flag());
 
 				delete _duals[v][i];
 				_duals[v][i] = NULL;
 			}
 			_duals[v].clear();
 
-			_cells[v].end_face();
+			if (inside)
+				_cells.end_face();
 		}
 		else
-			dt->compute_dual(v, _cells[v]);
+		{
+			dt->compute_dual(v, _dualCell);
+
+			bool inside = false;
+			for (int i = 0; i < _dualCell.points_number() && !inside; ++i)
+				inside = inside_domain(_dualCell.point(i));
+
+			for (int f = 0; f < _dualCell.faces_number() && inside; ++f)
+			{
+				_cells.begin_face();
+				for (int i = _dualCell.face_begin(f); i < _dualCell.face_end(f); ++i)
+					_cells.add_point(_dualCell.point(i), _dualCell.point_flag(i));
+				_cells.end_face();
+			}
+		}
+
+		_cells.end_cell(v);
 	}
 
 	template <typename Delaunay, typename Real>
@@ -460,7 +495,7 @@ namespace xyy
 			}
 		}
 
-		_cells[v].clear();
+		_cells.begin_cell(v);
 
 		if (!borders.empty())
 		{
@@ -476,12 +511,12 @@ namespace xyy
 					if (in[s])
 						continue;
 
-					_cells[v].begin_face();
+					_cells.begin_face();
 
 					DualSeg *temp = s;
 					do
 					{
-						_cells[v].add_point(temp->source(), temp->flag());
+						_cells.add_point(temp->source(), temp->flag());
 						in[temp] = true;
 
 						DualSeg *next = temp->next_segment();
@@ -496,10 +531,12 @@ namespace xyy
 
 					} while (temp != s);
 
-					_cells[v].end_face();
+					_cells.end_face();
 				}
 			}
 
+			end_cell(v);
+
 			int nb = (int)duals.size();
 			for (int i = 0; i < nb; ++i)
 			{
@@ -518,19 +555,57 @@ namespace xyy
 			return;
 		}
 
-		_cells[v].begin_face();
-
+		// not clipped, so entirely inside or outside the domain
 		int nb = (int)duals.size();
+
+		bool inside = false;
+		for (int i = 0; i < nb && !inside; ++i)
+			inside = inside_domain(duals[i]->source());
+
+		if (inside)
+			_cells.begin_face();
+
 		for (int i = 0; i < nb; ++i)
 		{
-			_cells[v].add_point(duals[i]->source(), duals[i]->flag());
+			if (inside)
+				_cells.add_point(duals[i]->source(), duals[i]->flag());
 
 			delete duals[i];
 			duals[i] = NULL;
 		}
 		duals.clear();
 
-		_cells[v].end_face();
+		if (inside)
+			_cells.end_face();
+
+		end_cell(v);
+	}
+
+	template <typename Delaunay, typename Real>
+	bool Voronoi2D<Delaunay, Real>::inside_domain(const Real *p) const
+	{
+		bool inside = false;
+		for (int f = 0; f < _domain.faces_number(); ++f)
+		{
+			int loc = locate_point_on_polygon2d(p[0], p[1], _domain.point(_domain.face_begin(f)), _domain.face_size(f));
+			if (loc == 0)
+				return true;
+
+			if (loc > 0)
+				inside = !inside;
+		}
+
+		return inside;
+	}
+
+	template <typename Delaunay, typename Real>
+	void Voronoi2D<Delaunay, Real>::end_cell(int v)
+	{
+		_cells.end_cell(v);
+
+		// incremental updates leave stale ranges behind
+		if (_cells.garbage() > _cells.points_number() / 2)
+			_cells.compact();
 	}
 
 	template <typename Delaunay, typename Real>